@@ -0,0 +1,100 @@
+#include "alloc_stats.h"
+#include <stdlib.h>
+
+static const char *subsystemNames[ALLOC_SUBSYSTEMS + 1] = {
+    "world", "food", "snakes", "networks", "arenas", "snapshots", "render", "recording", "threads", "total"
+};
+
+// updated with relaxed atomics: the render, checkpoint and arena threads allocate too
+static AllocCounter counters[ALLOC_SUBSYSTEMS + 1];
+static bool enabled = false;
+
+
+void enableAllocStats(void) {
+    enabled = true;
+}
+
+bool allocStatsEnabled(void) {
+    return enabled;
+}
+
+static void raisePeak(long long *peak, long long live) {
+    long long seen = __atomic_load_n(peak, __ATOMIC_RELAXED);
+    while (live > seen && !__atomic_compare_exchange_n(peak, &seen, live, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+static void track(AllocSubsystem subsystem, long long bytes, bool allocation) {
+    AllocCounter *counted[] = { &counters[subsystem], &counters[ALLOC_SUBSYSTEMS] };
+    for (int i = 0; i < 2; i++) {
+        AllocCounter *c = counted[i];
+        long long live = __atomic_add_fetch(&c->live, bytes, __ATOMIC_RELAXED);
+        if (allocation) {
+            __atomic_add_fetch(&c->allocations, 1, __ATOMIC_RELAXED);
+            raisePeak(&c->peak, live);
+        } else {
+            __atomic_add_fetch(&c->frees, 1, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+void *statMalloc(AllocSubsystem subsystem, size_t size) {
+    void *ptr = malloc(size);
+    if (enabled && ptr) track(subsystem, (long long)size, true);
+    return ptr;
+}
+
+void *statCalloc(AllocSubsystem subsystem, size_t count, size_t size) {
+    void *ptr = calloc(count, size);
+    if (enabled && ptr) track(subsystem, (long long)(count * size), true);
+    return ptr;
+}
+
+// counted as one allocation, a failed realloc leaves ptr and the counters as they were
+void *statRealloc(AllocSubsystem subsystem, void *ptr, size_t oldSize, size_t size) {
+    void *grown = realloc(ptr, size);
+    if (enabled && grown) track(subsystem, (long long)size - (long long)(ptr ? oldSize : 0), true);
+    return grown;
+}
+
+void statFree(AllocSubsystem subsystem, void *ptr, size_t size) {
+    if (!ptr) return;
+    free(ptr);
+    if (enabled) track(subsystem, -(long long)size, false);
+}
+
+void countAllocation(AllocSubsystem subsystem, size_t size) {
+    if (enabled && size) track(subsystem, (long long)size, true);
+}
+
+void countFree(AllocSubsystem subsystem, size_t size) {
+    if (enabled && size) track(subsystem, -(long long)size, false);
+}
+
+void readAllocStats(AllocCounter out[ALLOC_SUBSYSTEMS + 1]) {
+    for (int i = 0; i <= ALLOC_SUBSYSTEMS; i++) {
+        out[i].live = __atomic_load_n(&counters[i].live, __ATOMIC_RELAXED);
+        out[i].peak = __atomic_load_n(&counters[i].peak, __ATOMIC_RELAXED);
+        out[i].allocations = __atomic_load_n(&counters[i].allocations, __ATOMIC_RELAXED);
+        out[i].frees = __atomic_load_n(&counters[i].frees, __ATOMIC_RELAXED);
+    }
+}
+
+const char *allocSubsystemName(AllocSubsystem subsystem) {
+    return subsystemNames[subsystem];
+}
+
+unsigned long long allocationCount(void) {
+    return __atomic_load_n(&counters[ALLOC_SUBSYSTEMS].allocations, __ATOMIC_RELAXED);
+}
+
+void printAllocStats(FILE *out, const AllocCounter since[ALLOC_SUBSYSTEMS + 1], unsigned long ticks) {
+    AllocCounter now[ALLOC_SUBSYSTEMS + 1];
+    readAllocStats(now);
+    fprintf(out, "%-10s %12s %12s %12s %10s %12s\n", "subsystem", "live KiB", "peak KiB", "allocations", "frees", "allocs/tick");
+    for (int i = 0; i <= ALLOC_SUBSYSTEMS; i++) {
+        if (i < ALLOC_SUBSYSTEMS && now[i].peak == 0 && now[i].allocations == 0) continue; // never used by this program
+        unsigned long long allocations = now[i].allocations - since[i].allocations;
+        fprintf(out, "%-10s %12.1f %12.1f %12llu %10llu %12.4f\n", subsystemNames[i], now[i].live / 1024.0, now[i].peak / 1024.0,
+                now[i].allocations, now[i].frees, ticks ? (double)allocations / ticks : 0.0);
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef ALLOC_STATS_H
+#define ALLOC_STATS_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef enum {
+    ALLOC_WORLD,     // chunk tables and lazily allocated chunks, arena worlds included
+    ALLOC_FOOD,      // food list
+    ALLOC_SNAKES,    // snakes, bodies, vision and inference buffers
+    ALLOC_NETWORKS,  // population arenas and individually allocated networks
+    ALLOC_ARENAS,    // private evaluation arenas
+    ALLOC_SNAPSHOTS, // sim to render exchange and its cell change logs
+    ALLOC_RENDER,    // layer pixels and textures
+    ALLOC_RECORDING, // replay blocks and checkpoint buffers
+    ALLOC_THREADS,   // thread pool worker handles
+    ALLOC_SUBSYSTEMS
+} AllocSubsystem;
+
+typedef struct {
+    long long live; // bytes
+    long long peak;
+    unsigned long long allocations; // malloc, calloc and realloc calls
+    unsigned long long frees;
+} AllocCounter;
+
+// Opt-in accounting of the simulation's own allocations. Until enableAllocStats
+// the stat* wrappers go straight to the C allocator; it must be called before the
+// first tracked allocation, since frees are counted with the size the caller passes.
+void enableAllocStats(void);
+bool allocStatsEnabled(void);
+
+void *statMalloc(AllocSubsystem subsystem, size_t size);
+void *statCalloc(AllocSubsystem subsystem, size_t count, size_t size);
+void *statRealloc(AllocSubsystem subsystem, void *ptr, size_t oldSize, size_t size);
+void statFree(AllocSubsystem subsystem, void *ptr, size_t size);
+void countAllocation(AllocSubsystem subsystem, size_t size); // memory owned by a library, e.g. SDL textures; 0 is ignored
+void countFree(AllocSubsystem subsystem, size_t size);
+
+// counters[ALLOC_SUBSYSTEMS] holds the totals, whose peak is the real high-water mark
+void readAllocStats(AllocCounter counters[ALLOC_SUBSYSTEMS + 1]);
+const char *allocSubsystemName(AllocSubsystem subsystem);
+unsigned long long allocationCount(void); // all subsystems, cheap enough to read every tick
+void printAllocStats(FILE *out, const AllocCounter since[ALLOC_SUBSYSTEMS + 1], unsigned long ticks); // per tick rates since a snapshot
+
+#endif // ALLOC_STATS_H
@@ -0,0 +1,108 @@
+#include "arena.h"
+#include "alloc_stats.h"
+#include <stdlib.h>
+#include <string.h>
+
+
+bool initArena(Arena *arena, int size, int foodCount, int maxLength, const VisionEncoder *encoder, int numHidden) {
+    memset(arena, 0, sizeof(*arena));
+    arena->foodCount = foodCount;
+    arena->maxLength = maxLength;
+    arena->encoder = encoder;
+    arena->numHidden = numHidden;
+    size_t window = (size_t)encoder->window * encoder->window;
+    arena->body = (ArenaCell *)statMalloc(ALLOC_ARENAS, maxLength * sizeof(ArenaCell));
+    arena->roi = (float *)statMalloc(ALLOC_ARENAS, window * sizeof(float));
+    arena->input = (float *)statMalloc(ALLOC_ARENAS, encoder->inputs * sizeof(float));
+    arena->scratch = (float *)statMalloc(ALLOC_ARENAS, (visionScratchSize(encoder) + 1) * sizeof(float));
+    arena->hidden = (float *)statMalloc(ALLOC_ARENAS, numHidden * sizeof(float));
+    if (initWorld(&arena->world, size) || !arena->body || !arena->roi || !arena->input || !arena->scratch || !arena->hidden) {
+        freeArena(arena);
+        return true;
+    }
+    return false;
+}
+
+void freeArena(Arena *arena) {
+    freeWorld(&arena->world);
+    if (arena->encoder) {
+        const VisionEncoder *encoder = arena->encoder;
+        statFree(ALLOC_ARENAS, arena->body, arena->maxLength * sizeof(ArenaCell));
+        statFree(ALLOC_ARENAS, arena->roi, (size_t)encoder->window * encoder->window * sizeof(float));
+        statFree(ALLOC_ARENAS, arena->input, encoder->inputs * sizeof(float));
+        statFree(ALLOC_ARENAS, arena->scratch, (visionScratchSize(encoder) + 1) * sizeof(float));
+        statFree(ALLOC_ARENAS, arena->hidden, arena->numHidden * sizeof(float));
+    }
+    memset(arena, 0, sizeof(*arena));
+}
+
+// food on a random empty cell inside the walls, nothing if the arena is full
+static void spawnArenaFood(Arena *arena, unsigned int *seed) {
+    int inner = arena->world.size - 2;
+    for (int attempt = 0; attempt < inner * inner; attempt++) {
+        int x = 1 + rand_r(seed) % inner;
+        int y = 1 + rand_r(seed) % inner;
+        if (worldGet(&arena->world, x, y) == EMPTY_VALUE) {
+            worldSet(&arena->world, x, y, FOOD_VALUE);
+            return;
+        }
+    }
+}
+
+// Every evaluation with the same seed starts from the same walls, food and
+// head position, and replacement food comes from the same random stream, so
+// scores differ only through the brain's choices.
+int evaluateArena(Arena *arena, const NeuralNetwork *brain, unsigned int seed, int ticks) {
+    World *world = &arena->world;
+    int size = world->size;
+    int window = arena->encoder->window;
+    clearWorld(world);
+    for (int i = 0; i < size; i++) {
+        worldSet(world, i, 0, WALL_VALUE);
+        worldSet(world, i, size - 1, WALL_VALUE);
+        worldSet(world, 0, i, WALL_VALUE);
+        worldSet(world, size - 1, i, WALL_VALUE);
+    }
+    arena->bodyHead = 0;
+    arena->length = 1;
+    arena->body[0].x = arena->body[0].y = size / 2;
+    worldSet(world, size / 2, size / 2, BODY_VALUE);
+    for (int f = 0; f < arena->foodCount; f++) spawnArenaFood(arena, &seed);
+
+    int eaten = 0;
+    for (int t = 0; t < ticks; t++) {
+        ArenaCell head = arena->body[arena->bodyHead];
+        if (!arena->encoder->fovea) {
+            worldReadWindow(world, arena->input, head.x - window / 2, head.y - window / 2, window, window);
+        } else {
+            worldReadWindow(world, arena->roi, head.x - window / 2, head.y - window / 2, window, window);
+            encodeVision(arena->encoder, arena->roi, arena->input, arena->scratch);
+        }
+        // same action order as main.c: nothing, up, down, left, right
+        switch (inferAction(brain, arena->input, arena->hidden)) {
+            case 1: head.y--; break;
+            case 2: head.y++; break;
+            case 3: head.x--; break;
+            case 4: head.x++; break;
+            default: continue;
+        }
+        float cell = worldGet(world, head.x, head.y);
+        if (cell < 0) continue; // wall or body, the move is blocked
+
+        bool grow = cell == FOOD_VALUE;
+        if (!grow || arena->length == arena->maxLength) {
+            ArenaCell tail = arena->body[(arena->bodyHead - arena->length + 1 + arena->maxLength) % arena->maxLength];
+            worldSet(world, tail.x, tail.y, EMPTY_VALUE);
+        } else {
+            arena->length++;
+        }
+        arena->bodyHead = (arena->bodyHead + 1) % arena->maxLength;
+        arena->body[arena->bodyHead] = head;
+        worldSet(world, head.x, head.y, BODY_VALUE);
+        if (grow) {
+            eaten++;
+            spawnArenaFood(arena, &seed);
+        }
+    }
+    return eaten;
+}
@@ -0,0 +1,36 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include "world.h"
+#include "vision.h"
+#include "neural_network.h"
+#include <stdbool.h>
+
+typedef struct {
+    int x, y;
+} ArenaCell;
+
+// A private world for scoring one brain at a time: walls around the edge, a
+// food layout drawn from a seed and a single snake that moves, eats and grows
+// like the ones in main.c. Arenas are reused from candidate to candidate, so a
+// worker only ever holds one small world, one vision window and one body.
+typedef struct Arena {
+    World world;
+    int foodCount;
+    int maxLength;
+    const VisionEncoder *encoder;
+    ArenaCell *body; // ring buffer of maxLength segments
+    int bodyHead;
+    int length;
+    float *roi;     // window x window cells around the head
+    float *input;   // encoded network input
+    float *scratch;
+    float *hidden;  // inference scratch
+    int numHidden;
+} Arena;
+
+bool initArena(Arena *arena, int size, int foodCount, int maxLength, const VisionEncoder *encoder, int numHidden); // true on error
+void freeArena(Arena *arena);
+int evaluateArena(Arena *arena, const NeuralNetwork *brain, unsigned int seed, int ticks); // food eaten in ticks moves
+
+#endif // ARENA_H
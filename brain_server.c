@@ -0,0 +1,543 @@
+#define _GNU_SOURCE // ppoll
+#include "brain_server.h"
+#include "neural_network.h"
+#include "checkpoint.h"
+#include "thread_pool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define MAX_CLIENTS 64
+#define READ_CHUNK 65536
+#define MAX_QUEUED_OUTPUT (4 << 20) // queued reply bytes at which a client's input is no longer read
+#define DRAIN_MS 1000           // time left to write queued replies after a stop signal
+#define DEFAULT_BATCH 256       // observations that trigger a batch right away
+#define DEFAULT_BATCH_WAIT_US 200 // longest a request waits for others to join its batch
+#define DEFAULT_REPORT_SECONDS 10
+#define LATENCY_SUB_BUCKETS 16  // per power of two, about 6% resolution
+#define LATENCY_BUCKETS (48 * LATENCY_SUB_BUCKETS)
+
+// Client fds are non-blocking and replies go through a per-client queue that is
+// flushed when poll reports the fd writable, so a client that does not read its
+// replies only stalls itself.
+typedef struct {
+    int in, out; // the same socket, or stdin and stdout
+    unsigned char *buffer; // unparsed input
+    size_t used, capacity;
+    unsigned char *output; // replies, written up to outputSent
+    size_t outputUsed, outputSent, outputCapacity;
+    int pendingRequests; // requests waiting in the batch
+    bool hungUp;         // input ended, closed once every reply is written
+} Client;
+
+typedef struct {
+    int client;     // index into clients, -1 once that client is gone
+    BrainRequest request;
+    int first;      // first observation in the batch
+    uint64_t arrived; // ns, when the last byte was read
+} PendingRequest;
+
+// observations of all pending requests, evaluated in one pass over the pool
+typedef struct {
+    const NeuralNetwork **brains; // per observation
+    float *inputs;
+    float *scores;
+    uint32_t *actions;
+    float *hidden;  // per task
+    int count, capacity;
+    int tasks;
+} Batch;
+
+typedef struct {
+    unsigned long requests, observations, batches;
+    unsigned long histogram[LATENCY_BUCKETS]; // microseconds, log-linear
+    uint64_t maxLatency;
+} LatencyStats;
+
+NetworkArena *arenas = NULL; // one per checkpoint
+const NeuralNetwork **brains = NULL;
+int brainCount = 0;
+int inputCount = 0, outputCount = 0, maxHidden = 0;
+
+Client clients[MAX_CLIENTS];
+bool clientOpen[MAX_CLIENTS];
+PendingRequest *pending = NULL;
+int pendingCount = 0, pendingCapacity = 0;
+Batch batch;
+ThreadPool pool;
+LatencyStats stats;
+volatile sig_atomic_t stopping = 0;
+
+
+uint64_t nowNs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+void handleSignal(int signal) {
+    (void)signal;
+    stopping = 1;
+}
+
+int latencyBucket(uint64_t us) {
+    if (us < LATENCY_SUB_BUCKETS) return (int)us;
+    int power = 63 - __builtin_clzll(us); // >= 4
+    int bucket = (power - 3) * LATENCY_SUB_BUCKETS + (int)(us >> (power - 4)) - LATENCY_SUB_BUCKETS;
+    return bucket < LATENCY_BUCKETS ? bucket : LATENCY_BUCKETS - 1;
+}
+
+uint64_t bucketUpperBound(int bucket) {
+    if (bucket < LATENCY_SUB_BUCKETS) return bucket;
+    int power = bucket / LATENCY_SUB_BUCKETS + 3;
+    uint64_t low = (uint64_t)(LATENCY_SUB_BUCKETS + bucket % LATENCY_SUB_BUCKETS) << (power - 4);
+    return low + (1ull << (power - 4)) - 1;
+}
+
+uint64_t latencyPercentile(const LatencyStats *s, double fraction) {
+    unsigned long target = (unsigned long)(fraction * s->requests + 0.5), seen = 0;
+    if (target == 0) target = 1;
+    for (int b = 0; b < LATENCY_BUCKETS; b++) {
+        seen += s->histogram[b];
+        if (seen >= target) {
+            uint64_t bound = bucketUpperBound(b);
+            return bound < s->maxLatency ? bound : s->maxLatency;
+        }
+    }
+    return s->maxLatency;
+}
+
+void printStats(const LatencyStats *s, double seconds) {
+    if (!s->requests) {
+        fprintf(stderr, "No requests served\n");
+        return;
+    }
+    fprintf(stderr, "%lu requests, %lu observations in %lu batches (%.1f per batch), %.0f observations/sec\n",
+            s->requests, s->observations, s->batches, (double)s->observations / s->batches, s->observations / seconds);
+    fprintf(stderr, "latency us: p50 %llu  p90 %llu  p99 %llu  p99.9 %llu  max %llu\n",
+            (unsigned long long)latencyPercentile(s, 0.5), (unsigned long long)latencyPercentile(s, 0.9),
+            (unsigned long long)latencyPercentile(s, 0.99), (unsigned long long)latencyPercentile(s, 0.999),
+            (unsigned long long)s->maxLatency);
+}
+
+// room for size more bytes at the end of the client's reply queue, NULL if it cannot grow
+unsigned char *reserveOutput(Client *client, size_t size) {
+    if (client->outputSent == client->outputUsed) client->outputSent = client->outputUsed = 0;
+    if (client->outputUsed + size > client->outputCapacity && client->outputSent) {
+        memmove(client->output, client->output + client->outputSent, client->outputUsed - client->outputSent);
+        client->outputUsed -= client->outputSent;
+        client->outputSent = 0;
+    }
+    if (client->outputUsed + size > client->outputCapacity) {
+        size_t capacity = client->outputCapacity ? client->outputCapacity * 2 : 4096;
+        while (capacity < client->outputUsed + size) capacity *= 2;
+        unsigned char *grown = (unsigned char *)realloc(client->output, capacity);
+        if (!grown) return NULL;
+        client->output = grown;
+        client->outputCapacity = capacity;
+    }
+    unsigned char *dst = client->output + client->outputUsed;
+    client->outputUsed += size;
+    return dst;
+}
+
+size_t queuedOutput(const Client *client) {
+    return client->outputUsed - client->outputSent;
+}
+
+// writes as much of the reply queue as the fd takes without blocking; false once the client is gone
+bool flushClient(Client *client) {
+    while (queuedOutput(client)) {
+        ssize_t n = write(client->out, client->output + client->outputSent, queuedOutput(client));
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;
+        if (n <= 0) return false;
+        client->outputSent += n;
+    }
+    return true;
+}
+
+void closeClient(int c) {
+    if (clients[c].in > 2) close(clients[c].in);
+    free(clients[c].buffer);
+    free(clients[c].output);
+    memset(&clients[c], 0, sizeof(clients[c]));
+    clientOpen[c] = false;
+    for (int p = 0; p < pendingCount; p++)
+        if (pending[p].client == c) pending[p].client = -1;
+}
+
+bool openClient(int in, int out) {
+    int c = 0;
+    while (c < MAX_CLIENTS && clientOpen[c]) c++;
+    if (c == MAX_CLIENTS) return true;
+    BrainHello hello = { BRAIN_SERVER_MAGIC, BRAIN_SERVER_VERSION, (uint32_t)brainCount, (uint32_t)inputCount, (uint32_t)outputCount };
+    unsigned char *dst = reserveOutput(&clients[c], sizeof(hello));
+    if (!dst) {
+        closeClient(c);
+        return true;
+    }
+    memcpy(dst, &hello, sizeof(hello));
+    clients[c].in = in;
+    clients[c].out = out;
+    clientOpen[c] = true;
+    return false;
+}
+
+bool reserveBatch(int count) {
+    if (batch.count + count <= batch.capacity) return true;
+    int capacity = batch.capacity ? batch.capacity : DEFAULT_BATCH;
+    while (capacity < batch.count + count) capacity *= 2;
+    const NeuralNetwork **grownBrains = (const NeuralNetwork **)realloc(batch.brains, capacity * sizeof(*grownBrains));
+    if (grownBrains) batch.brains = grownBrains;
+    float *grownInputs = (float *)realloc(batch.inputs, (size_t)capacity * inputCount * sizeof(float));
+    if (grownInputs) batch.inputs = grownInputs;
+    float *grownScores = (float *)realloc(batch.scores, (size_t)capacity * outputCount * sizeof(float));
+    if (grownScores) batch.scores = grownScores;
+    uint32_t *grownActions = (uint32_t *)realloc(batch.actions, capacity * sizeof(uint32_t));
+    if (grownActions) batch.actions = grownActions;
+    if (!grownBrains || !grownInputs || !grownScores || !grownActions) return false;
+    batch.capacity = capacity;
+    return true;
+}
+
+// moves every complete request out of the client's buffer into the batch; false on a protocol error
+bool parseRequests(int c, uint64_t now) {
+    Client *client = &clients[c];
+    size_t offset = 0;
+    while (client->used - offset >= sizeof(BrainRequest)) {
+        BrainRequest request;
+        memcpy(&request, client->buffer + offset, sizeof(request));
+        if (request.brain >= (uint32_t)brainCount || request.count > BRAIN_MAX_OBSERVATIONS) {
+            fprintf(stderr, "Client %d sent an invalid request (brain %u, %u observations), disconnecting\n", c, request.brain, request.count);
+            return false;
+        }
+        size_t size = sizeof(request) + (size_t)request.count * inputCount * sizeof(float);
+        if (client->used - offset < size) break;
+
+        if (pendingCount == pendingCapacity) {
+            int capacity = pendingCapacity ? pendingCapacity * 2 : 64;
+            PendingRequest *grown = (PendingRequest *)realloc(pending, capacity * sizeof(PendingRequest));
+            if (!grown) return false;
+            pending = grown;
+            pendingCapacity = capacity;
+        }
+        if (!reserveBatch(request.count)) return false;
+        PendingRequest *p = &pending[pendingCount++];
+        client->pendingRequests++;
+        p->client = c;
+        p->request = request;
+        p->first = batch.count;
+        p->arrived = now;
+        memcpy(&batch.inputs[(size_t)batch.count * inputCount], client->buffer + offset + sizeof(request),
+               (size_t)request.count * inputCount * sizeof(float));
+        for (uint32_t i = 0; i < request.count; i++) batch.brains[batch.count + i] = brains[request.brain];
+        batch.count += request.count;
+        offset += size;
+    }
+    memmove(client->buffer, client->buffer + offset, client->used - offset);
+    client->used -= offset;
+    return true;
+}
+
+// false if the client misbehaved or its connection failed; an ordinary hang up only sets hungUp
+bool readClient(int c) {
+    Client *client = &clients[c];
+    if (client->capacity - client->used < READ_CHUNK) {
+        size_t capacity = client->used + READ_CHUNK;
+        unsigned char *grown = (unsigned char *)realloc(client->buffer, capacity);
+        if (!grown) return false;
+        client->buffer = grown;
+        client->capacity = capacity;
+    }
+    ssize_t n = read(client->in, client->buffer + client->used, client->capacity - client->used);
+    if (n < 0 && (errno == EINTR || errno == EAGAIN)) return true;
+    if (n < 0) return false;
+    if (n == 0) {
+        client->hungUp = true; // a trailing partial request is dropped
+        return true;
+    }
+    client->used += n;
+    return parseRequests(c, nowNs());
+}
+
+void evaluateSlice(void *ctx, int index) {
+    (void)ctx;
+    int first = (int)((long)batch.count * index / batch.tasks);
+    int last = (int)((long)batch.count * (index + 1) / batch.tasks);
+    float *hidden = &batch.hidden[(size_t)index * maxHidden];
+    for (int i = first; i < last; i++) {
+        batch.actions[i] = (uint32_t)inferScores(batch.brains[i], &batch.inputs[(size_t)i * inputCount], hidden,
+                                                 &batch.scores[(size_t)i * outputCount]);
+    }
+}
+
+// a client that hung up is closed once its last reply is written; false if it was closed
+bool serviceClient(int c) {
+    if (!flushClient(&clients[c]) || (clients[c].hungUp && !clients[c].pendingRequests && !queuedOutput(&clients[c]))) {
+        closeClient(c);
+        return false;
+    }
+    return true;
+}
+
+// evaluates every pending observation, then queues the answers in arrival order and writes what the clients take
+void runBatch() {
+    if (!pendingCount) return;
+    runThreadPool(&pool, batch.tasks, evaluateSlice, NULL);
+
+    size_t recordSize = sizeof(uint32_t) + outputCount * sizeof(float);
+    for (int p = 0; p < pendingCount; p++) {
+        PendingRequest *request = &pending[p];
+        if (request->client < 0) continue;
+        Client *client = &clients[request->client];
+        client->pendingRequests--;
+        BrainResponse response = { request->request.id, request->request.count };
+        unsigned char *dst = reserveOutput(client, sizeof(response) + request->request.count * recordSize);
+        if (!dst) {
+            closeClient(request->client);
+            continue;
+        }
+        memcpy(dst, &response, sizeof(response));
+        dst += sizeof(response);
+        for (uint32_t i = 0; i < request->request.count; i++, dst += recordSize) {
+            int o = request->first + i;
+            memcpy(dst, &batch.actions[o], sizeof(uint32_t));
+            memcpy(dst + sizeof(uint32_t), &batch.scores[(size_t)o * outputCount], outputCount * sizeof(float));
+        }
+        uint64_t latency = (nowNs() - request->arrived) / 1000;
+        stats.histogram[latencyBucket(latency)]++;
+        if (latency > stats.maxLatency) stats.maxLatency = latency;
+        stats.requests++;
+        stats.observations += request->request.count;
+    }
+    stats.batches++;
+    pendingCount = 0;
+    batch.count = 0;
+    for (int c = 0; c < MAX_CLIENTS; c++)
+        if (clientOpen[c]) serviceClient(c);
+}
+
+// brains of every checkpoint, given as a file or as a prefix whose newest <prefix>.<n>.ckpt is used
+bool loadBrains(char **paths, int count) {
+    arenas = (NetworkArena *)calloc(count, sizeof(NetworkArena));
+    if (!arenas) return true;
+    for (int f = 0; f < count; f++) {
+        char path[CHECKPOINT_FILE_MAX];
+        if (latestCheckpoint(paths[f], path, sizeof(path))) snprintf(path, sizeof(path), "%s", paths[f]);
+        CheckpointHeader header;
+        if (readCheckpointHeader(path, &header)) return true;
+        if (f == 0) {
+            inputCount = (int)header.numInput;
+            outputCount = (int)header.numOutput;
+        } else if ((int)header.numInput != inputCount || (int)header.numOutput != outputCount) {
+            fprintf(stderr, "%s has %u inputs and %u outputs, the first checkpoint %d and %d\n", path, header.numInput,
+                    header.numOutput, inputCount, outputCount);
+            return true;
+        }
+        if (header.count == 0 || initNetworkArena(&arenas[f], header.count, header.numInput, header.numHidden, header.numOutput) ||
+            loadCheckpoint(path, arenas[f].networks, header.count, &header)) return true;
+        if ((int)header.numHidden > maxHidden) maxHidden = (int)header.numHidden;
+        brainCount += header.count;
+        fprintf(stderr, "Loaded %u brains (%ux%ux%u) from %s\n", header.count, header.numInput, header.numHidden, header.numOutput, path);
+    }
+    brains = (const NeuralNetwork **)malloc(brainCount * sizeof(NeuralNetwork *));
+    if (!brains) return true;
+    for (int f = 0, b = 0; f < count; f++)
+        for (int n = 0; n < arenas[f].count; n++) brains[b++] = &arenas[f].networks[n];
+    return false;
+}
+
+int listenSocket(const char *path) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "Socket path %s is too long\n", path);
+        return -1;
+    }
+    strcpy(address.sun_path, path);
+    unlink(path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(fd, MAX_CLIENTS) != 0) {
+        perror("Could not listen on socket");
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    return fd;
+}
+
+// In stdin mode stdout carries the protocol, so everything else goes to stderr.
+int main(int argc, char **argv) {
+    const char *socketPath = NULL;
+    int threads = 1, batchSize = DEFAULT_BATCH, batchWaitUs = DEFAULT_BATCH_WAIT_US, reportSeconds = DEFAULT_REPORT_SECONDS;
+    int first = 1;
+    for (; first < argc && strncmp(argv[first], "--", 2) == 0; first += 2) {
+        const char *arg = argv[first];
+        const char *value = first + 1 < argc ? argv[first + 1] : NULL;
+        if (!value) break;
+        if (strcmp(arg, "--socket") == 0) socketPath = value;
+        else if (strcmp(arg, "--threads") == 0) threads = atoi(value);
+        else if (strcmp(arg, "--batch") == 0) batchSize = atoi(value);
+        else if (strcmp(arg, "--batch-wait-us") == 0) batchWaitUs = atoi(value);
+        else if (strcmp(arg, "--report-every") == 0) reportSeconds = atoi(value);
+        else { fprintf(stderr, "Unknown option %s\n", arg); first = argc; break; }
+    }
+    if (first >= argc || threads < 1 || batchSize < 1 || batchWaitUs < 0 || reportSeconds < 0) {
+        fprintf(stderr, "Usage: %s [--socket PATH] [--threads N] [--batch N] [--batch-wait-us N] [--report-every SECONDS] CHECKPOINT...\n"
+                        "Serves over stdin/stdout unless --socket is given. CHECKPOINT is a .ckpt file or a checkpoint prefix.\n", argv[0]);
+        return 1;
+    }
+    if (loadBrains(argv + first, argc - first)) return 1;
+
+    // SIGINT and SIGTERM are only delivered inside ppoll, without SA_RESTART, so they always end the wait;
+    // blocked before the pool starts so no worker thread takes them
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = handleSignal;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+    sigset_t stopSignals, pollMask;
+    sigemptyset(&stopSignals);
+    sigaddset(&stopSignals, SIGINT);
+    sigaddset(&stopSignals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stopSignals, &pollMask);
+
+    batch.tasks = threads;
+    batch.hidden = (float *)malloc((size_t)threads * maxHidden * sizeof(float));
+    if (!batch.hidden || !reserveBatch(batchSize) || initThreadPool(&pool, threads)) {
+        fprintf(stderr, "Could not start %d inference threads\n", threads);
+        return 1;
+    }
+
+    int listener = -1;
+    int stdioFlags[2] = { fcntl(STDIN_FILENO, F_GETFL), fcntl(STDOUT_FILENO, F_GETFL) }; // restored on exit
+    if (socketPath) {
+        if ((listener = listenSocket(socketPath)) < 0) return 1;
+        fprintf(stderr, "Serving %d brains on %s\n", brainCount, socketPath);
+    } else {
+        fcntl(STDIN_FILENO, F_SETFL, stdioFlags[0] | O_NONBLOCK);
+        fcntl(STDOUT_FILENO, F_SETFL, stdioFlags[1] | O_NONBLOCK);
+        if (openClient(STDIN_FILENO, STDOUT_FILENO)) return 1;
+    }
+
+    uint64_t start = nowNs(), lastReport = start;
+    while (!stopping) {
+        struct pollfd fds[2 * MAX_CLIENTS + 1];
+        int owners[2 * MAX_CLIENTS + 1];
+        int count = 0, open = 0;
+        if (listener >= 0) {
+            fds[count].fd = listener;
+            fds[count].events = POLLIN;
+            owners[count++] = -1;
+        }
+        for (int c = 0; c < MAX_CLIENTS; c++) {
+            if (!clientOpen[c]) continue;
+            open++;
+            // a client whose replies pile up is not read until it catches up
+            if (!clients[c].hungUp && queuedOutput(&clients[c]) < MAX_QUEUED_OUTPUT) {
+                fds[count].fd = clients[c].in;
+                fds[count].events = POLLIN;
+                owners[count++] = c;
+            }
+            if (queuedOutput(&clients[c])) {
+                fds[count].fd = clients[c].out;
+                fds[count].events = POLLOUT;
+                owners[count++] = c;
+            }
+        }
+        if (listener < 0 && open == 0) break; // stdin closed and every reply written
+
+        // wait for input, but no longer than the oldest pending request may wait for company
+        uint64_t waitNs = reportSeconds ? (uint64_t)reportSeconds * 1000000000ull : 1000000000ull;
+        if (pendingCount) {
+            uint64_t deadline = pending[0].arrived + (uint64_t)batchWaitUs * 1000, now = nowNs();
+            waitNs = deadline > now ? deadline - now : 0;
+        }
+        struct timespec timeout = { (time_t)(waitNs / 1000000000ull), (long)(waitNs % 1000000000ull) };
+        int ready = ppoll(fds, count, &timeout, &pollMask);
+        if (ready < 0 && errno != EINTR) {
+            perror("poll");
+            break;
+        }
+
+        for (int i = 0; i < count && ready > 0; i++) {
+            if (!fds[i].revents) continue;
+            int c = owners[i];
+            if (c < 0) {
+                int fd;
+                while ((fd = accept4(listener, NULL, NULL, SOCK_NONBLOCK)) >= 0) {
+                    if (openClient(fd, fd)) close(fd);
+                }
+                continue;
+            }
+            if (!clientOpen[c]) continue; // closed earlier in this pass
+            if (fds[i].events == POLLOUT) {
+                serviceClient(c);
+            } else if (!readClient(c)) {
+                closeClient(c);
+            } else if (clients[c].hungUp) {
+                serviceClient(c); // closes it once its pending requests are answered
+            }
+        }
+
+        if (pendingCount && (batch.count >= batchSize || nowNs() >= pending[0].arrived + (uint64_t)batchWaitUs * 1000)) runBatch();
+        if (reportSeconds && nowNs() - lastReport >= (uint64_t)reportSeconds * 1000000000ull) {
+            printStats(&stats, (nowNs() - start) / 1e9);
+            lastReport = nowNs();
+        }
+    }
+    runBatch(); // answer whatever already arrived, and give the clients a moment to take it
+    uint64_t drainEnd = nowNs() + DRAIN_MS * 1000000ull;
+    for (uint64_t now = nowNs(); now < drainEnd; now = nowNs()) {
+        struct pollfd fds[MAX_CLIENTS];
+        int owners[MAX_CLIENTS];
+        int count = 0;
+        for (int c = 0; c < MAX_CLIENTS; c++) {
+            if (!clientOpen[c] || !queuedOutput(&clients[c])) continue;
+            fds[count].fd = clients[c].out;
+            fds[count].events = POLLOUT;
+            owners[count++] = c;
+        }
+        if (count == 0) break;
+        struct timespec timeout = { (time_t)((drainEnd - now) / 1000000000ull), (long)((drainEnd - now) % 1000000000ull) };
+        if (ppoll(fds, count, &timeout, NULL) <= 0) break;
+        for (int i = 0; i < count; i++)
+            if (fds[i].revents && !flushClient(&clients[owners[i]])) closeClient(owners[i]);
+    }
+
+    printStats(&stats, (nowNs() - start) / 1e9);
+    for (int c = 0; c < MAX_CLIENTS; c++)
+        if (clientOpen[c]) closeClient(c);
+    if (listener >= 0) {
+        close(listener);
+        unlink(socketPath);
+    } else {
+        fcntl(STDIN_FILENO, F_SETFL, stdioFlags[0]);
+        fcntl(STDOUT_FILENO, F_SETFL, stdioFlags[1]);
+    }
+    destroyThreadPool(&pool);
+    for (int f = 0; f < argc - first; f++) cleanupNetworkArena(&arenas[f]);
+    free(arenas);
+    free(brains);
+    free(pending);
+    free(batch.brains);
+    free(batch.inputs);
+    free(batch.scores);
+    free(batch.actions);
+    free(batch.hidden);
+    return 0;
+}
@@ -0,0 +1,36 @@
+#ifndef BRAIN_SERVER_H
+#define BRAIN_SERVER_H
+
+#include <stdint.h>
+
+#define BRAIN_SERVER_MAGIC "SNBS"
+#define BRAIN_SERVER_VERSION 1
+#define BRAIN_MAX_OBSERVATIONS 65536 // per request
+
+// Wire protocol of brain_server, host byte order like the checkpoints it serves.
+// On connect the server sends a BrainHello. A client then sends any number of
+// requests, each a BrainRequest followed by count observations of inputCount
+// floats (the encoded vision input the networks were trained on). Every request
+// is answered, in order per client, by a BrainResponse followed by count
+// BrainResult records of a u32 action and outputCount float scores. Requests of
+// several clients are evaluated together in one batch.
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t brainCount;  // networks of all loaded checkpoints, in command line order
+    uint32_t inputCount;
+    uint32_t outputCount;
+} BrainHello;
+
+typedef struct {
+    uint32_t id;    // echoed in the response
+    uint32_t brain; // index below brainCount
+    uint32_t count; // observations that follow, at most BRAIN_MAX_OBSERVATIONS
+} BrainRequest;
+
+typedef struct {
+    uint32_t id;
+    uint32_t count;
+} BrainResponse;
+
+#endif // BRAIN_SERVER_H
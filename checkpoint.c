@@ -0,0 +1,328 @@
+#include "checkpoint.h"
+#include "alloc_stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <dirent.h>
+#include <unistd.h>
+
+
+static double millisecondsSince(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1e3 + (now.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+static size_t floatsPerNetwork(int numInput, int numHidden, int numOutput) {
+    return (size_t)numHidden * (numInput + 1) + (size_t)numOutput * (numHidden + 1);
+}
+
+// hidden then output neurons, each as weights followed by bias; mode 's' packs, 'l' unpacks
+static float *transferNetwork(NeuralNetwork *nn, float *data, char mode) {
+    Layer *layers[] = {&nn->hidden_layer, &nn->output_layer};
+    int num_weights[] = {nn->num_input, nn->hidden_layer.num_neurons};
+    for (int l = 0; l < 2; l++) {
+        for (int i = 0; i < layers[l]->num_neurons; i++) {
+            Neuron *neuron = &layers[l]->neurons[i];
+            size_t bytes = num_weights[l] * sizeof(float);
+            mode == 's' ? memcpy(data, neuron->weights, bytes) : memcpy(neuron->weights, data, bytes);
+            data += num_weights[l];
+            mode == 's' ? (*data = neuron->bias) : (neuron->bias = *data);
+            data++;
+        }
+    }
+    return data;
+}
+
+// splits "dir/prefix" so checkpoints can be found with readdir
+static void splitBase(const char *base, char *dir, size_t dirSize, const char **prefix) {
+    const char *slash = strrchr(base, '/');
+    if (slash) {
+        snprintf(dir, dirSize, "%.*s", (int)(slash - base + 1), base);
+        *prefix = slash + 1;
+    } else {
+        snprintf(dir, dirSize, ".");
+        *prefix = base;
+    }
+}
+
+// calls visit for the sequence number of every <base>.<n>.ckpt on disk
+static void scanSequences(const char *base, void (*visit)(void *ctx, long sequence), void *ctx) {
+    char dir[CHECKPOINT_PATH_MAX];
+    const char *prefix;
+    splitBase(base, dir, sizeof(dir), &prefix);
+    DIR *d = opendir(dir);
+    if (!d) return;
+
+    size_t prefixLength = strlen(prefix);
+    struct dirent *entry;
+    while ((entry = readdir(d))) {
+        const char *name = entry->d_name;
+        if (strncmp(name, prefix, prefixLength) != 0 || name[prefixLength] != '.') continue;
+        char *end;
+        long sequence = strtol(name + prefixLength + 1, &end, 10);
+        if (end != name + prefixLength + 1 && sequence >= 0 && strcmp(end, ".ckpt") == 0) visit(ctx, sequence);
+    }
+    closedir(d);
+}
+
+static void findNewest(void *ctx, long sequence) {
+    long *newest = (long *)ctx;
+    if (sequence > *newest) *newest = sequence;
+}
+
+// highest sequence number of <base>.<n>.ckpt on disk, or -1
+static long newestSequence(const char *base) {
+    long newest = -1;
+    scanSequences(base, findNewest, &newest);
+    return newest;
+}
+
+static void checkpointPath(const CheckpointWriter *writer, unsigned long sequence, char *path, size_t size) {
+    snprintf(path, size, "%s.%lu.ckpt", writer->base, sequence);
+}
+
+// keeps the writer's ring sorted oldest first while it is seeded from disk
+static void keepNewest(void *ctx, long sequence) {
+    CheckpointWriter *writer = (CheckpointWriter *)ctx;
+    unsigned long *kept = writer->kept;
+    int n = writer->keptCount;
+    if (n == writer->keep) {
+        if ((unsigned long)sequence <= kept[0]) return;
+        memmove(kept, kept + 1, --n * sizeof(unsigned long)); // drop the oldest
+    } else {
+        writer->keptCount++;
+    }
+    while (n > 0 && kept[n - 1] > (unsigned long)sequence) {
+        kept[n] = kept[n - 1];
+        n--;
+    }
+    kept[n] = (unsigned long)sequence;
+}
+
+static void removeOlder(void *ctx, long sequence) {
+    CheckpointWriter *writer = (CheckpointWriter *)ctx;
+    if (writer->keptCount < writer->keep || (unsigned long)sequence >= writer->kept[0]) return;
+    char path[CHECKPOINT_FILE_MAX];
+    checkpointPath(writer, (unsigned long)sequence, path, sizeof(path));
+    remove(path);
+}
+
+static bool writeCheckpointFile(const char *path, const CheckpointHeader *header, const float *data, size_t floats) {
+    char temporary[CHECKPOINT_FILE_MAX + 8];
+    snprintf(temporary, sizeof(temporary), "%s.tmp", path);
+    FILE *file = fopen(temporary, "wb");
+    if (!file) return true;
+    bool failed = fwrite(header, sizeof(*header), 1, file) != 1 || fwrite(data, sizeof(float), floats, file) != floats;
+    failed |= fflush(file) != 0 || fsync(fileno(file)) != 0;
+    failed |= fclose(file) != 0;
+    if (failed || rename(temporary, path) != 0) {
+        remove(temporary);
+        return true;
+    }
+    return false;
+}
+
+static void *checkpointThread(void *arg) {
+    CheckpointWriter *writer = (CheckpointWriter *)arg;
+    pthread_mutex_lock(&writer->lock);
+    for (;;) {
+        while (!writer->hasPending && !writer->stopping) pthread_cond_wait(&writer->wake, &writer->lock);
+        if (!writer->hasPending) break;
+
+        // take the snapshot by swapping buffers, the copy was already made by the submitter
+        float *data = writer->pending;
+        size_t capacity = writer->pendingCapacity;
+        writer->pending = writer->writing;
+        writer->pendingCapacity = writer->writingCapacity;
+        writer->writing = data;
+        writer->writingCapacity = capacity;
+        CheckpointHeader header = writer->pendingHeader;
+        writer->hasPending = false;
+        unsigned long sequence = writer->nextSequence++;
+        pthread_mutex_unlock(&writer->lock);
+
+        char path[CHECKPOINT_FILE_MAX];
+        checkpointPath(writer, sequence, path, sizeof(path));
+        size_t floats = header.count * floatsPerNetwork(header.numInput, header.numHidden, header.numOutput);
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        bool failed = writeCheckpointFile(path, &header, data, floats);
+        double ms = millisecondsSince(&start);
+
+        if (failed) {
+            fprintf(stderr, "Could not write checkpoint %s\n", path);
+        } else {
+            // rotate: forget the oldest once `keep` newer ones exist
+            int slot;
+            if (writer->keptCount < writer->keep) {
+                slot = writer->keptCount++;
+            } else {
+                slot = writer->keptOldest;
+                writer->keptOldest = (slot + 1) % writer->keep;
+                char old[CHECKPOINT_FILE_MAX];
+                checkpointPath(writer, writer->kept[slot], old, sizeof(old));
+                remove(old);
+            }
+            writer->kept[slot] = sequence;
+        }
+
+        pthread_mutex_lock(&writer->lock);
+        if (failed) {
+            writer->failed++;
+        } else {
+            writer->written++;
+            writer->totalWriteMs += ms;
+            if (ms > writer->maxWriteMs) writer->maxWriteMs = ms;
+        }
+    }
+    pthread_mutex_unlock(&writer->lock);
+    return NULL;
+}
+
+bool startCheckpointWriter(CheckpointWriter *writer, const char *base, int keep) {
+    memset(writer, 0, sizeof(*writer));
+    if (strlen(base) >= CHECKPOINT_PATH_MAX || keep < 1) return true;
+    strcpy(writer->base, base);
+    writer->keep = keep;
+    writer->kept = (unsigned long *)statCalloc(ALLOC_RECORDING, keep, sizeof(unsigned long));
+    if (!writer->kept) return true;
+    // earlier runs' files take part in the rotation, the newest `keep` of them seed the ring
+    scanSequences(base, keepNewest, writer);
+    scanSequences(base, removeOlder, writer);
+    writer->nextSequence = writer->keptCount ? writer->kept[writer->keptCount - 1] + 1 : 0; // never overwrite an earlier run's files
+    pthread_mutex_init(&writer->lock, NULL);
+    pthread_cond_init(&writer->wake, NULL);
+    if (pthread_create(&writer->thread, NULL, checkpointThread, writer) != 0) {
+        pthread_mutex_destroy(&writer->lock);
+        pthread_cond_destroy(&writer->wake);
+        statFree(ALLOC_RECORDING, writer->kept, keep * sizeof(unsigned long));
+        writer->kept = NULL;
+        return true;
+    }
+    writer->running = true;
+    return false;
+}
+
+void submitCheckpoint(CheckpointWriter *writer, NeuralNetwork *networks, int count, uint64_t step, uint32_t generation, uint32_t seed) {
+    if (!writer->running || count < 1) return;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    size_t floats = count * floatsPerNetwork(networks[0].num_input, networks[0].hidden_layer.num_neurons, networks[0].output_layer.num_neurons);
+
+    pthread_mutex_lock(&writer->lock);
+    if (floats > writer->pendingCapacity) {
+        float *grown = (float *)statRealloc(ALLOC_RECORDING, writer->pending, writer->pendingCapacity * sizeof(float), floats * sizeof(float));
+        if (!grown) {
+            writer->failed++;
+            pthread_mutex_unlock(&writer->lock);
+            return;
+        }
+        writer->pending = grown;
+        writer->pendingCapacity = floats;
+    }
+    if (writer->hasPending) writer->superseded++;
+
+    float *data = writer->pending;
+    for (int n = 0; n < count; n++) data = transferNetwork(&networks[n], data, 's');
+    CheckpointHeader *header = &writer->pendingHeader;
+    memcpy(header->magic, CHECKPOINT_MAGIC, 4);
+    header->version = CHECKPOINT_VERSION;
+    header->count = count;
+    header->numInput = networks[0].num_input;
+    header->numHidden = networks[0].hidden_layer.num_neurons;
+    header->numOutput = networks[0].output_layer.num_neurons;
+    header->step = step;
+    header->generation = generation;
+    header->seed = seed;
+    writer->hasPending = true;
+    pthread_cond_signal(&writer->wake);
+    pthread_mutex_unlock(&writer->lock);
+
+    double ms = millisecondsSince(&start);
+    writer->totalSubmitMs += ms;
+    if (ms > writer->maxSubmitMs) writer->maxSubmitMs = ms;
+}
+
+void stopCheckpointWriter(CheckpointWriter *writer) {
+    if (!writer->running) return;
+    pthread_mutex_lock(&writer->lock);
+    writer->stopping = true;
+    pthread_cond_signal(&writer->wake);
+    pthread_mutex_unlock(&writer->lock);
+    pthread_join(writer->thread, NULL);
+    writer->running = false;
+
+    pthread_mutex_destroy(&writer->lock);
+    pthread_cond_destroy(&writer->wake);
+    statFree(ALLOC_RECORDING, writer->pending, writer->pendingCapacity * sizeof(float));
+    statFree(ALLOC_RECORDING, writer->writing, writer->writingCapacity * sizeof(float));
+    statFree(ALLOC_RECORDING, writer->kept, writer->keep * sizeof(unsigned long));
+    writer->pending = writer->writing = NULL;
+    writer->kept = NULL;
+}
+
+void printCheckpointStats(const CheckpointWriter *writer) {
+    int submitted = writer->written + writer->superseded + writer->failed;
+    if (submitted == 0) return;
+    printf("Checkpoints: %d written, %d superseded, %d failed; write avg %.2fms max %.2fms, submit avg %.3fms max %.3fms\n",
+           writer->written, writer->superseded, writer->failed,
+           writer->written ? writer->totalWriteMs / writer->written : 0, writer->maxWriteMs,
+           writer->totalSubmitMs / submitted, writer->maxSubmitMs);
+}
+
+bool latestCheckpoint(const char *base, char *path, size_t size) {
+    long sequence = newestSequence(base);
+    if (sequence < 0) return true;
+    snprintf(path, size, "%s.%ld.ckpt", base, sequence);
+    return false;
+}
+
+// NULL on error, otherwise positioned after a valid header
+static FILE *openCheckpoint(const char *path, CheckpointHeader *header) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "Could not open checkpoint %s\n", path);
+        return NULL;
+    }
+    if (fread(header, sizeof(*header), 1, file) != 1 || memcmp(header->magic, CHECKPOINT_MAGIC, 4) != 0 ||
+        header->version != CHECKPOINT_VERSION) {
+        fprintf(stderr, "%s is not a checkpoint\n", path);
+        fclose(file);
+        return NULL;
+    }
+    return file;
+}
+
+bool readCheckpointHeader(const char *path, CheckpointHeader *header) {
+    FILE *file = openCheckpoint(path, header);
+    if (file) fclose(file);
+    return file == NULL;
+}
+
+bool loadCheckpoint(const char *path, NeuralNetwork *networks, int count, CheckpointHeader *header) {
+    FILE *file = openCheckpoint(path, header);
+    if (!file) return true;
+    if ((int)header->numInput != networks[0].num_input || (int)header->numHidden != networks[0].hidden_layer.num_neurons ||
+        (int)header->numOutput != networks[0].output_layer.num_neurons) {
+        fprintf(stderr, "Checkpoint %s holds %ux%ux%u networks, expected %dx%dx%d\n", path, header->numInput, header->numHidden,
+                header->numOutput, networks[0].num_input, networks[0].hidden_layer.num_neurons, networks[0].output_layer.num_neurons);
+        fclose(file);
+        return true;
+    }
+
+    // networks beyond the checkpoint's count keep their weights
+    bool failed = false;
+    size_t floats = floatsPerNetwork(header->numInput, header->numHidden, header->numOutput);
+    float *data = (float *)statMalloc(ALLOC_RECORDING, floats * sizeof(float));
+    int loaded = count < (int)header->count ? count : (int)header->count;
+    for (int n = 0; !failed && n < loaded; n++) {
+        failed = !data || fread(data, sizeof(float), floats, file) != floats;
+        if (!failed) transferNetwork(&networks[n], data, 'l');
+    }
+    statFree(ALLOC_RECORDING, data, floats * sizeof(float));
+    fclose(file);
+    if (failed) fprintf(stderr, "Checkpoint %s is truncated or corrupt\n", path);
+    return failed;
+}
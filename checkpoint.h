@@ -0,0 +1,67 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "neural_network.h"
+#include <pthread.h>
+#include <stddef.h>
+
+#define CHECKPOINT_MAGIC "SNCK"
+#define CHECKPOINT_VERSION 1
+#define CHECKPOINT_PATH_MAX 256
+#define CHECKPOINT_FILE_MAX (CHECKPOINT_PATH_MAX + 32) // base plus ".<n>.ckpt"
+
+// Binary checkpoint: this header, then for every network the hidden and output
+// neurons in order, each as its weights followed by its bias (host byte order).
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t count;
+    uint32_t numInput;
+    uint32_t numHidden;
+    uint32_t numOutput;
+    uint64_t step;       // ticks or training samples when the snapshot was taken
+    uint32_t generation;
+    uint32_t seed;       // run seed, 0 in checkpoints written before it was stored
+} CheckpointHeader;
+
+// Snapshots are packed on the submitting thread (one copy of the weights) and
+// written by a background thread to <base>.<sequence>.ckpt through a temporary
+// file and rename(), so a crash never leaves a torn checkpoint. Only the newest
+// `keep` files with this base are kept, including those of earlier runs. A
+// snapshot submitted while the previous one is still waiting replaces it.
+typedef struct CheckpointWriter {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    bool running;
+    bool stopping;
+    char base[CHECKPOINT_PATH_MAX];
+    int keep;
+    unsigned long nextSequence;
+    unsigned long *kept; // ring of the last `keep` sequences on disk
+    int keptCount;
+    int keptOldest;      // slot of the oldest kept sequence once the ring is full
+
+    bool hasPending;
+    CheckpointHeader pendingHeader;
+    float *pending;
+    size_t pendingCapacity;
+    float *writing;
+    size_t writingCapacity;
+
+    // stats, milliseconds
+    int written, superseded, failed;
+    double totalWriteMs, maxWriteMs;
+    double totalSubmitMs, maxSubmitMs;
+} CheckpointWriter;
+
+bool startCheckpointWriter(CheckpointWriter *writer, const char *base, int keep); // true on error
+void submitCheckpoint(CheckpointWriter *writer, NeuralNetwork *networks, int count, uint64_t step, uint32_t generation, uint32_t seed);
+void stopCheckpointWriter(CheckpointWriter *writer); // finishes a waiting snapshot, then joins
+void printCheckpointStats(const CheckpointWriter *writer);
+
+bool latestCheckpoint(const char *base, char *path, size_t size); // true if there is none
+bool readCheckpointHeader(const char *path, CheckpointHeader *header); // true on error, for sizing networks before loadCheckpoint
+bool loadCheckpoint(const char *path, NeuralNetwork *networks, int count, CheckpointHeader *header); // true on error
+
+#endif // CHECKPOINT_H
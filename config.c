@@ -0,0 +1,214 @@
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+typedef enum { OPT_INT, OPT_FLOAT, OPT_STRING } OptionType;
+
+typedef struct ConfigOption {
+    const char *name;
+    OptionType type;
+    size_t offset;
+    const char *help;
+} ConfigOption;
+
+static const ConfigOption options[] = {
+    { "grid-size",   OPT_INT, offsetof(GameConfig, gridSize),   "world side length in cells" },
+    { "snakes",      OPT_INT, offsetof(GameConfig, snakeCount), "population size" },
+    { "food",        OPT_INT, offsetof(GameConfig, foodCount),  "food items kept in the world" },
+    { "search-size", OPT_INT, offsetof(GameConfig, searchSize), "side of each snake's vision window (odd)" },
+    { "fovea",       OPT_INT, offsetof(GameConfig, fovea),      "full-resolution centre of the window (odd), 0 disables pooling" },
+    { "vision-rings", OPT_INT, offsetof(GameConfig, visionRings), "pooled rings around the fovea" },
+    { "max-length",  OPT_INT, offsetof(GameConfig, maxLength),  "longest snake body in segments, 1 keeps snakes a single cell" },
+    { "evolve-time", OPT_INT, offsetof(GameConfig, evolveTime), "milliseconds per generation" },
+    { "cull-idle",    OPT_INT, offsetof(GameConfig, cullIdle),    "ticks without moving before a snake is culled, 0 off" },
+    { "cull-stagnant", OPT_INT, offsetof(GameConfig, cullStagnant), "ticks without eating before a snake is culled, 0 off" },
+    { "cull-margin",  OPT_INT, offsetof(GameConfig, cullMargin),  "food behind the leader at which a snake is culled, 0 off" },
+    { "cull-grace",   OPT_INT, offsetof(GameConfig, cullGrace),   "ticks a snake is evaluated before cull-margin applies" },
+    { "cull-respawn", OPT_INT, offsetof(GameConfig, cullRespawn), "1 replaces culled snakes with offspring of the leader" },
+    { "generation-ticks", OPT_INT, offsetof(GameConfig, generationTicks), "ticks per generation, 0 uses evolve-time" },
+    { "arena-size",  OPT_INT, offsetof(GameConfig, arenaSize),  "score brains alone in arenas this wide, 0 uses shared-world food" },
+    { "arena-ticks", OPT_INT, offsetof(GameConfig, arenaTicks), "moves per arena evaluation" },
+    { "arena-food",  OPT_INT, offsetof(GameConfig, arenaFood),  "food items per arena" },
+    { "arena-threads", OPT_INT, offsetof(GameConfig, arenaThreads), "arena evaluation threads, 0 uses one per CPU" },
+    { "seed",        OPT_INT, offsetof(GameConfig, seed),       "random seed, 0 picks one from the clock" },
+    { "telemetry",   OPT_STRING, offsetof(GameConfig, telemetryPath), "binary per-generation log file, empty disables" },
+    { "checkpoint",  OPT_STRING, offsetof(GameConfig, checkpointPath), "checkpoint file prefix" },
+    { "checkpoint-every", OPT_INT, offsetof(GameConfig, checkpointEvery), "generations between checkpoints, 0 saves only on 's'" },
+    { "checkpoint-keep",  OPT_INT, offsetof(GameConfig, checkpointKeep),  "checkpoints kept on disk" },
+    { "record",      OPT_STRING, offsetof(GameConfig, recordPath), "write a replay log of seed, actions, food and fitness" },
+    { "replay",      OPT_STRING, offsetof(GameConfig, replayPath), "re-run a replay log and report the first divergence" },
+    { "replay-tolerance", OPT_FLOAT, offsetof(GameConfig, replayTolerance), "fraction of replayed actions allowed to differ" },
+    { "headless",    OPT_INT, offsetof(GameConfig, headless),   "1 runs without a window" },
+    { "ticks",       OPT_INT, offsetof(GameConfig, ticks),      "stop after this many ticks, 0 runs until quit" },
+    { "alloc-report", OPT_INT, offsetof(GameConfig, allocReport), "seconds between memory and allocation reports, 0 off" },
+};
+#define OPTION_COUNT (int)(sizeof(options) / sizeof(options[0]))
+
+
+void defaultConfig(GameConfig *config) {
+    config->gridSize = 500;
+    config->snakeCount = 9;
+    config->foodCount = 2000;
+    config->searchSize = 51;
+    config->fovea = 0;
+    config->visionRings = 4;
+    config->maxLength = 32;
+    config->evolveTime = 10000;
+    config->generationTicks = 0;
+    config->cullIdle = 0;
+    config->cullStagnant = 0;
+    config->cullMargin = 0;
+    config->cullGrace = 200;
+    config->cullRespawn = 1;
+    config->arenaSize = 0;
+    config->arenaTicks = 500;
+    config->arenaFood = 40;
+    config->arenaThreads = 0;
+    config->seed = 0;
+    config->telemetryPath[0] = '\0';
+    strcpy(config->checkpointPath, "checkpoint");
+    config->checkpointEvery = 0;
+    config->checkpointKeep = 3;
+    config->recordPath[0] = '\0';
+    config->replayPath[0] = '\0';
+    config->replayTolerance = 0;
+    config->headless = 0;
+    config->ticks = 0;
+    config->allocReport = 0;
+}
+
+static bool setOption(GameConfig *config, const char *name, const char *value) {
+    for (int i = 0; i < OPTION_COUNT; i++) {
+        if (strcmp(options[i].name, name) != 0) continue;
+        char *end = (char *)value;
+        void *field = (char *)config + options[i].offset;
+        switch (options[i].type) {
+            case OPT_INT:
+                *(int *)field = (int)strtol(value, &end, 10);
+                break;
+            case OPT_FLOAT:
+                *(float *)field = strtof(value, &end);
+                break;
+            case OPT_STRING:
+                if (strlen(value) >= CONFIG_PATH_MAX) {
+                    fprintf(stderr, "Value for %s is too long\n", name);
+                    return true;
+                }
+                strcpy((char *)field, value);
+                return false;
+        }
+        if (end == value || *end != '\0') {
+            fprintf(stderr, "Invalid value '%s' for %s\n", value, name);
+            return true;
+        }
+        return false;
+    }
+    fprintf(stderr, "Unknown option '%s'\n", name);
+    return true;
+}
+
+bool loadConfigFile(GameConfig *config, const char *filename) {
+    FILE *file = fopen(filename, "r");
+    if (!file) { fprintf(stderr, "Could not open config file %s\n", filename); return true; }
+
+    char line[256];
+    int lineNumber = 0;
+    bool failed = false;
+    while (!failed && fgets(line, sizeof(line), file)) {
+        lineNumber++;
+        char name[64], value[128];
+        char *comment = strchr(line, '#');
+        if (comment) *comment = '\0';
+        if (sscanf(line, " %63[^= \t] = %127s", name, value) == 2) {
+            failed = setOption(config, name, value);
+        } else if (strspn(line, " \t\r\n") != strlen(line)) {
+            fprintf(stderr, "%s:%d: expected 'key = value'\n", filename, lineNumber);
+            failed = true;
+        }
+    }
+    fclose(file);
+    return failed;
+}
+
+bool parseConfigArgs(GameConfig *config, int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (strncmp(arg, "--", 2) != 0) {
+            fprintf(stderr, "Unexpected argument '%s'\n", arg);
+            return true;
+        }
+        arg += 2;
+        if (strcmp(arg, "help") == 0) return true;
+
+        char name[64];
+        const char *value;
+        const char *eq = strchr(arg, '=');
+        if (eq) {
+            snprintf(name, sizeof(name), "%.*s", (int)(eq - arg), arg);
+            value = eq + 1;
+        } else {
+            if (i + 1 >= argc) { fprintf(stderr, "Missing value for --%s\n", arg); return true; }
+            snprintf(name, sizeof(name), "%s", arg);
+            value = argv[++i];
+        }
+
+        if (strcmp(name, "config") == 0) {
+            if (loadConfigFile(config, value)) return true;
+        } else if (setOption(config, name, value)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool validateConfig(const GameConfig *config) {
+    bool invalid = false;
+    if (config->gridSize < 32) { fprintf(stderr, "grid-size must be at least 32\n"); invalid = true; }
+    if (config->snakeCount < 1) { fprintf(stderr, "snakes must be at least 1\n"); invalid = true; }
+    if (config->foodCount < 0) { fprintf(stderr, "food must not be negative\n"); invalid = true; }
+    if (config->searchSize < 1 || config->searchSize % 2 == 0) { fprintf(stderr, "search-size must be odd and positive\n"); invalid = true; }
+    if (config->maxLength < 1) { fprintf(stderr, "max-length must be at least 1\n"); invalid = true; }
+    if (config->evolveTime < 1) { fprintf(stderr, "evolve-time must be positive\n"); invalid = true; }
+    if (config->checkpointEvery < 0) { fprintf(stderr, "checkpoint-every must not be negative\n"); invalid = true; }
+    if (config->checkpointKeep < 1) { fprintf(stderr, "checkpoint-keep must be at least 1\n"); invalid = true; }
+    if (config->cullIdle < 0 || config->cullStagnant < 0 || config->cullMargin < 0 || config->cullGrace < 0) {
+        fprintf(stderr, "cull thresholds must not be negative\n");
+        invalid = true;
+    }
+    if (config->arenaSize && (config->arenaSize < 8 || config->arenaTicks < 1 || config->arenaFood < 0 || config->arenaThreads < 0)) {
+        fprintf(stderr, "arena-size must be 0 or at least 8, arena-ticks positive\n");
+        invalid = true;
+    }
+    if (config->generationTicks < 0 || config->ticks < 0) { fprintf(stderr, "generation-ticks and ticks must not be negative\n"); invalid = true; }
+    if (config->allocReport < 0) { fprintf(stderr, "alloc-report must not be negative\n"); invalid = true; }
+    if (config->recordPath[0] && config->replayPath[0]) { fprintf(stderr, "record and replay are exclusive\n"); invalid = true; }
+    if (config->recordPath[0] && config->generationTicks == 0 && !config->arenaSize) {
+        fprintf(stderr, "record needs generation-ticks, wall-clock generations cannot be replayed\n");
+        invalid = true;
+    }
+    if (config->headless && !config->ticks && !config->replayPath[0]) { fprintf(stderr, "headless needs ticks or replay\n"); invalid = true; }
+    return invalid;
+}
+
+void printConfigUsage(const char *program) {
+    GameConfig defaults;
+    defaultConfig(&defaults);
+    fprintf(stderr, "Usage: %s [--config FILE] [--option VALUE | --option=VALUE]...\n", program);
+    for (int i = 0; i < OPTION_COUNT; i++) {
+        const void *field = (const char *)&defaults + options[i].offset;
+        switch (options[i].type) {
+            case OPT_INT:
+                fprintf(stderr, "  --%-14s %s (default %d)\n", options[i].name, options[i].help, *(const int *)field);
+                break;
+            case OPT_FLOAT:
+                fprintf(stderr, "  --%-14s %s (default %g)\n", options[i].name, options[i].help, *(const float *)field);
+                break;
+            case OPT_STRING:
+                fprintf(stderr, "  --%-14s %s (default '%s')\n", options[i].name, options[i].help, (const char *)field);
+                break;
+        }
+    }
+    fprintf(stderr, "Config files hold one 'option = value' per line, '#' starts a comment.\n");
+}
@@ -0,0 +1,46 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <stdbool.h>
+
+#define CONFIG_PATH_MAX 256
+
+typedef struct GameConfig {
+    int gridSize;
+    int snakeCount;
+    int foodCount;
+    int searchSize;  // side of the square window each snake sees, odd
+    int fovea;       // full-resolution centre of the window, the rest is pooled; 0 uses the whole window
+    int visionRings; // pooling rings around the fovea
+    int maxLength;   // body segments a snake can grow to, including the head
+    int evolveTime;  // ms per generation
+    int cullIdle;     // stop evaluating a snake after this many ticks without moving, 0 off
+    int cullStagnant; // ... after this many ticks without eating, 0 off
+    int cullMargin;   // ... once it trails the generation's leader by this much food, 0 off
+    int cullGrace;    // ticks a snake runs before the margin applies
+    int cullRespawn;  // 1 replaces a culled snake with a mutated copy of the leader
+    int generationTicks; // ticks per generation, 0 uses evolveTime instead
+    int arenaSize;    // >0: score each brain alone in an arena this wide instead of by shared-world food
+    int arenaTicks;   // moves per arena evaluation
+    int arenaFood;    // food items in an arena
+    int arenaThreads; // workers evaluating arenas, 0 uses one per CPU
+    int seed;        // 0 picks one from the clock
+    char telemetryPath[CONFIG_PATH_MAX]; // per-generation telemetry log, empty to disable
+    char checkpointPath[CONFIG_PATH_MAX]; // checkpoints go to <path>.<n>.ckpt
+    int checkpointEvery; // generations between automatic checkpoints, 0 for manual saves only
+    int checkpointKeep;  // newest checkpoints kept on disk
+    char recordPath[CONFIG_PATH_MAX]; // replay log to write
+    char replayPath[CONFIG_PATH_MAX]; // replay log to verify against
+    float replayTolerance; // fraction of actions allowed to differ during a replay
+    int headless;    // run the simulation without a window
+    int ticks;       // stop after this many ticks, 0 runs until quit
+    int allocReport; // seconds between allocation reports, 0 turns allocation accounting off
+} GameConfig;
+
+void defaultConfig(GameConfig *config);
+bool loadConfigFile(GameConfig *config, const char *filename); // true on error
+bool parseConfigArgs(GameConfig *config, int argc, char **argv); // true on error, handles --config FILE
+bool validateConfig(const GameConfig *config); // true if invalid
+void printConfigUsage(const char *program);
+
+#endif // CONFIG_H
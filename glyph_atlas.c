@@ -0,0 +1,92 @@
+#include "glyph_atlas.h"
+#include "alloc_stats.h"
+#include <stdio.h>
+#include <string.h>
+
+
+bool buildGlyphAtlas(GlyphAtlas *atlas, SDL_Renderer *renderer, TTF_Font *font, SDL_Color color) {
+    SDL_Surface *glyphSurfaces[GLYPH_COUNT] = {0};
+    int cellWidth = 0;
+    int cellHeight = TTF_FontHeight(font);
+    bool failed = false;
+
+    memset(atlas, 0, sizeof(*atlas));
+    atlas->lineHeight = cellHeight;
+
+    for (int i = 0; i < GLYPH_COUNT; i++) {
+        Uint16 ch = (Uint16)(GLYPH_FIRST + i);
+        if (TTF_GlyphMetrics(font, ch, NULL, NULL, NULL, NULL, &atlas->advance[i]) != 0) atlas->advance[i] = 0;
+        glyphSurfaces[i] = TTF_RenderGlyph_Blended(font, ch, color);
+        if (!glyphSurfaces[i]) continue; // glyph missing from the font, drawn as blank space
+        if (glyphSurfaces[i]->w > cellWidth) cellWidth = glyphSurfaces[i]->w;
+        if (glyphSurfaces[i]->h > cellHeight) cellHeight = glyphSurfaces[i]->h;
+    }
+
+    int rows = (GLYPH_COUNT + GLYPHS_PER_ROW - 1) / GLYPHS_PER_ROW;
+    SDL_Surface *sheet = SDL_CreateRGBSurfaceWithFormat(0, cellWidth * GLYPHS_PER_ROW, cellHeight * rows, 32, SDL_PIXELFORMAT_RGBA32);
+    if (!sheet) {
+        fprintf(stderr, "Could not create glyph atlas: %s\n", SDL_GetError());
+        failed = true;
+        goto cleanup;
+    }
+
+    for (int i = 0; i < GLYPH_COUNT; i++) {
+        SDL_Rect cell = { (i % GLYPHS_PER_ROW) * cellWidth, (i / GLYPHS_PER_ROW) * cellHeight, 0, 0 };
+        if (glyphSurfaces[i]) {
+            cell.w = glyphSurfaces[i]->w;
+            cell.h = glyphSurfaces[i]->h;
+            SDL_SetSurfaceBlendMode(glyphSurfaces[i], SDL_BLENDMODE_NONE); // copy coverage as-is
+            SDL_BlitSurface(glyphSurfaces[i], NULL, sheet, &cell);
+        }
+        atlas->glyphs[i] = cell;
+    }
+
+    atlas->texture = SDL_CreateTextureFromSurface(renderer, sheet);
+    atlas->bytes = atlas->texture ? (size_t)sheet->w * sheet->h * 4 : 0;
+    SDL_FreeSurface(sheet);
+    if (!atlas->texture) {
+        fprintf(stderr, "Could not upload glyph atlas: %s\n", SDL_GetError());
+        failed = true;
+        goto cleanup;
+    }
+    SDL_SetTextureBlendMode(atlas->texture, SDL_BLENDMODE_BLEND);
+    countAllocation(ALLOC_RENDER, atlas->bytes);
+
+cleanup:
+    for (int i = 0; i < GLYPH_COUNT; i++) SDL_FreeSurface(glyphSurfaces[i]);
+    return failed;
+}
+
+void destroyGlyphAtlas(GlyphAtlas *atlas) {
+    if (atlas->texture) SDL_DestroyTexture(atlas->texture);
+    countFree(ALLOC_RENDER, atlas->bytes);
+    atlas->texture = NULL;
+    atlas->bytes = 0;
+}
+
+bool setTextLine(TextLine *line, const GlyphAtlas *atlas, const char *text, int x, int y) {
+    if (line->length > 0 && strncmp(line->text, text, TEXT_LINE_MAX) == 0) return false;
+
+    int penX = x;
+    line->length = 0;
+    for (const char *c = text; *c && line->length < TEXT_LINE_MAX - 1; c++) {
+        int i = (unsigned char)*c;
+        i = (i < GLYPH_FIRST || i > GLYPH_LAST ? '?' : i) - GLYPH_FIRST;
+        SDL_Rect src = atlas->glyphs[i];
+        SDL_Rect dst = { penX, y, src.w, src.h };
+        line->text[line->length] = *c;
+        line->src[line->length] = src;
+        line->dst[line->length] = dst;
+        line->length++;
+        penX += atlas->advance[i];
+    }
+    line->text[line->length] = '\0';
+    return true;
+}
+
+void drawTextLine(SDL_Renderer *renderer, const GlyphAtlas *atlas, const TextLine *line) {
+    for (int i = 0; i < line->length; i++) {
+        if (line->src[i].w == 0) continue; // space
+        SDL_RenderCopy(renderer, atlas->texture, &line->src[i], &line->dst[i]);
+    }
+}
@@ -0,0 +1,36 @@
+#ifndef GLYPH_ATLAS_H
+#define GLYPH_ATLAS_H
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+#include <stdbool.h>
+
+#define GLYPH_FIRST 32  // ' '
+#define GLYPH_LAST 126  // '~'
+#define GLYPH_COUNT (GLYPH_LAST - GLYPH_FIRST + 1)
+#define GLYPHS_PER_ROW 16
+#define TEXT_LINE_MAX 64
+
+// every printable ASCII glyph rendered once into a single texture
+typedef struct GlyphAtlas {
+    SDL_Texture *texture;
+    SDL_Rect glyphs[GLYPH_COUNT]; // source rect of each glyph inside the texture
+    int advance[GLYPH_COUNT];
+    int lineHeight;
+    size_t bytes; // texture pixels, for allocation accounting
+} GlyphAtlas;
+
+// a laid out string: one atlas quad per character, rebuilt only when the text changes
+typedef struct TextLine {
+    char text[TEXT_LINE_MAX];
+    int length;
+    SDL_Rect src[TEXT_LINE_MAX];
+    SDL_Rect dst[TEXT_LINE_MAX];
+} TextLine;
+
+bool buildGlyphAtlas(GlyphAtlas *atlas, SDL_Renderer *renderer, TTF_Font *font, SDL_Color color); // true on error
+void destroyGlyphAtlas(GlyphAtlas *atlas);
+bool setTextLine(TextLine *line, const GlyphAtlas *atlas, const char *text, int x, int y); // true if re-laid out
+void drawTextLine(SDL_Renderer *renderer, const GlyphAtlas *atlas, const TextLine *line);
+
+#endif // GLYPH_ATLAS_H
@@ -1,8 +1,20 @@
 #include "neural_network.h"
+#include "glyph_atlas.h"
+#include "sim_channel.h"
+#include "world.h"
+#include "config.h"
+#include "telemetry.h"
+#include "checkpoint.h"
+#include "replay.h"
+#include "vision.h"
+#include "thread_pool.h"
+#include "arena.h"
+#include "alloc_stats.h"
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_ttf.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <unistd.h>
@@ -11,18 +23,15 @@
 #include <limits.h>
 
 
-#define GRID_SIZE 500
 #define WALL_SHIFT 5
-#define FOOD_VALUE 1.0f
-#define WALL_VALUE -1.0f
-#define EMPTY_VALUE 0.0f
-#define FOOD_COUNT 2000
-#define SRCH_SIZE 51
-#define SNAKE_COUNT 9
-#define EVOLVE_TIME 10000
 #define RENDER_DELAY 10
+#define MAX_VIEW_SIZE 1000 // larger worlds are drawn downscaled
 #define NUM_HIDDEN_LAYER_NEURONS 4
-#define DEBUGGING 1
+#define MAX_CHANGED_CELLS 4096
+#define PLACE_ATTEMPTS 64 // random tries before placeSnake scans for an empty cell
+#define WALL_COLOR 0x960000FFu // ARGB
+#define FOOD_COLOR 0xFFFF0000u // ARGB
+#define BODY_COLOR 0xFF00B400u // ARGB
 
 #define MIN(a, b) ((a) < (b) ? (a) : (b))
 #define MAX(a, b) ((a) > (b) ? (a) : (b))
@@ -31,11 +40,21 @@ typedef struct {
     int x, y;
 } Point;
 
+// The body is a ring buffer of config.maxLength segments ending at the head.
+// Its cells hold BODY_VALUE in the world, so the world doubles as the occupancy
+// grid: a collision check is one worldGet and a move touches two cells.
 typedef struct {
-    Point position;
-    NeuralNetwork brain;
+    Point position; // head
+    Point* body;    // maxLength segments in bodySegments
+    int bodyHead;   // index of the head segment
+    int length;
+    NeuralNetwork* brain; // lives in the current population arena
     int foodsEaten;
     int actionsSinceLastFood;
+    int ticksSinceFood; // unlike actionsSinceLastFood, not reset by mutation
+    int idleTicks;      // consecutive ticks without moving
+    unsigned long startTick; // placed on the grid, respawns restart their grace period
+    bool culled;        // evaluation stopped until the next generation
     bool touchWall;
     bool firstInit;
 } Snake;
@@ -49,28 +68,85 @@ typedef enum {
 } Action;
 
 
-float grid[GRID_SIZE][GRID_SIZE];
-Snake snakes[SNAKE_COUNT];
+GameConfig config;
+World world;
+Snake* snakes = NULL;
+Point* bodySegments = NULL;
+NetworkArena populations[2]; // parents and children, swapped every generation
+int currentPopulation = 0;
+float* visionBuffer = NULL;
+VisionEncoder visionEncoder;
+float* roiBuffer = NULL;     // raw window before foveated encoding
+float* visionScratch = NULL;
+float* hiddenScratch = NULL; // inference scratch of the simulation thread
 Point* foodArray = NULL;
-Point changedFoodCoord;
 int foodExisting = 0;
+int foodCapacity = 0; // doubles as needed and never shrinks, so a steady-state tick does not allocate
 int evolutionEvents = 0;
 int rendering = 1;
-SDL_Texture* snakeTextures[SNAKE_COUNT];
-SDL_Texture* foodTexture;
-bool areWallsDrawn = false;
-bool isFoodDrawnInitial = false;
-bool isTextChanged = true;
-bool isFoodChanged = true;
-
-char prevCounterText[SNAKE_COUNT][32];
-char prevEvolutionEventsText[32];
-char prevMutationRateText[32];
-char prevMutationMagnitudeText[32];
+TelemetryLog runLog; // written by the simulation thread only
+CheckpointWriter checkpoints;
+Replay replay;
+float* generationFitness = NULL;
+
+// early culling: snakes that cannot win the generation stop using evaluation ticks
+unsigned long generationStartTick = 0;
+Uint32 generationStartTime = 0;
+int aliveSnakes = 0;
+int placedSnakes = 0; // found room at the start of the generation, only their culls can decide it early
+int leaderIndex = -1; // most food this generation, -1 until someone eats
+int leaderFoods = 0;
+CullingRecord generationCulls;
+CullingRecord totalCulls;
+unsigned long evaluatedSnakeTicks = 0;
+
+// arena evaluation: one private arena per pool task, fitness written to generationFitness
+ThreadPool arenaPool;
+Arena* arenas = NULL;
+int arenaCount = 0;
+unsigned int arenaSeed = 0; // food layout shared by every arena of a generation
+unsigned long arenaEvaluations = 0;
+double arenaSeconds = 0;
+
+// simulation thread state, shared with the render thread only through the channel
+SnapshotExchange exchange;
+CommandQueue commands;
+SDL_atomic_t simRunning;
+unsigned long simTicks = 0;
+float ticksPerSecond = 0;
+
+// allocation accounting (--alloc-report): counters at the first tick and at the last periodic report
+AllocCounter allocStart[ALLOC_SUBSYSTEMS + 1];
+AllocCounter allocLastReport[ALLOC_SUBSYSTEMS + 1];
+unsigned long allocStartTick = 0;
+unsigned long allocLastReportTick = 0;
+unsigned long allocatingTicks = 0; // ticks in which any thread allocated
+unsigned long allocLastReportAllocatingTicks = 0;
+
+// cached render layers (render thread): walls never change, food is patched per changed cell
+SDL_Texture* wallTexture = NULL;
+SDL_Texture* foodTexture = NULL;
+int viewScale = 1; // world cells per pixel along each axis
+int viewSize = 0;  // window and layer side in pixels
+Uint32* foodPixels = NULL; // food and snake bodies share the streaming layer
+Uint16* foodCounts = NULL; // food cells covered by each pixel
+Uint16* bodyCounts = NULL; // snake segments covered by each pixel
+Point changedFoodCells[MAX_CHANGED_CELLS];
+int changedFoodCount = 0;
+bool foodTextureStale = true;
+
+// HUD text, re-laid out from the glyph atlas only when a string changes
+GlyphAtlas hudAtlas;
+TextLine* counterLines = NULL;
+int hudRows = 0;
+TextLine evolutionEventsLine;
+TextLine mutationRateLine;
+TextLine mutationMagnitudeLine;
+TextLine ticksPerSecondLine;
 
 
 // neural network architecture
-int num_input = SRCH_SIZE*SRCH_SIZE;
+int num_input;
 int num_hidden1 = NUM_HIDDEN_LAYER_NEURONS;
 int num_output = 5;
 
@@ -79,14 +155,26 @@ float mutationMagnitude = 0.01;
 
 
 // function prototypes
-void initializeGrid();
 bool checkSnakeOnFood(int x, int y);
 void updateGameLogic();
-void initializeSnakes();
+int initializeSnakes();
+bool placeSnake(int s);
+void moveSnake(int s, int x, int y, bool grow);
+void clearBody(int s);
+void setCell(int x, int y, float value);
+void feedSnake(int s);
 void evolveSnakes();
+bool cullingEnabled();
+void cullSnake(int s, uint32_t* reason);
+void findLeader();
+void printCullStats();
+bool startArenas();
+void evaluateArenaShard(void* ctx, int index);
+void evaluateArenas();
+void stopArenas();
 bool snakeTakeAction(int s, Action act);
 void extractROI(float vision[], int x, int y);
-void processSnake(int s);
+bool processSnake(int s);
 bool checkMoveValid(int x, int y);
 void pushFood(int x, int y);
 Point popFood();
@@ -94,137 +182,567 @@ void eatFood(int x, int y);
 void spawnFood(int x, int y);
 void spawnFoods();
 void spawnWalls();
-void renderText(SDL_Renderer* renderer, TTF_Font* font, const char* text, int x, int y, SDL_Color textColor);
-bool stringChanged(const char* str1, const char* str2);
-void renderGame(SDL_Renderer* renderer, TTF_Font* font);
+int runSimulation(void* data);
+bool simulateTick();
+void handleCommands();
+void applyCommand(SimCommand cmd);
+bool startReplay();
+void publishWorldState();
+void markCellChanged(int x, int y, float previous, float value);
+void applyCellChanges(const WorldSnapshot* view);
+bool initRenderLayers(SDL_Renderer* renderer, TTF_Font* font);
+void updateFoodTexture();
+void cleanupRenderLayers();
+void renderGame(SDL_Renderer* renderer, const WorldSnapshot* view);
 void handleEvents(int* running);
 bool init_SDL(SDL_Window** window, SDL_Renderer** renderer, TTF_Font** font);
 float randomFloatInRange(float range);
 void manageNeuralNetworks(char action);
+void startAllocReport();
+void reportAllocations();
+void printAllocReport();
+size_t textureBytes(SDL_Texture* texture);
 
 
-int main(void){
-    srand((unsigned int)(time(NULL) + getpid()));
+int main(int argc, char** argv){
+    defaultConfig(&config);
+    if(parseConfigArgs(&config, argc, argv) || validateConfig(&config)){
+        printConfigUsage(argv[0]);
+        return 1;
+    }
+    if(config.seed == 0) config.seed = (int)((time(NULL) + getpid()) & 0x7FFFFFFF);
+    if(config.allocReport) enableAllocStats();
+    if(startReplay()) return 1;
+    srand((unsigned int)config.seed);
+
+    viewScale = (config.gridSize + MAX_VIEW_SIZE - 1) / MAX_VIEW_SIZE;
+    viewSize = (config.gridSize + viewScale - 1) / viewScale;
     SDL_Window *window = NULL;
     SDL_Renderer *renderer = NULL;
     TTF_Font* font = NULL;
-    if(init_SDL(&window, &renderer, &font)) return 1;
-    
-    initializeGrid();
+    if(!config.headless && init_SDL(&window, &renderer, &font)) return 1;
+
+    if(initVisionEncoder(&visionEncoder, config.searchSize, config.fovea, config.visionRings)) return 1;
+    num_input = visionEncoder.inputs;
+    snakes = (Snake*)statCalloc(ALLOC_SNAKES, config.snakeCount, sizeof(Snake));
+    bodySegments = (Point*)statMalloc(ALLOC_SNAKES, (size_t)config.snakeCount * config.maxLength * sizeof(Point));
+    visionBuffer = (float*)statMalloc(ALLOC_SNAKES, num_input * sizeof(float));
+    roiBuffer = (float*)statMalloc(ALLOC_SNAKES, (size_t)config.searchSize * config.searchSize * sizeof(float));
+    visionScratch = (float*)statMalloc(ALLOC_SNAKES, (visionScratchSize(&visionEncoder) + 1) * sizeof(float));
+    generationFitness = (float*)statMalloc(ALLOC_SNAKES, config.snakeCount * sizeof(float));
+    hiddenScratch = (float*)statMalloc(ALLOC_SNAKES, num_hidden1 * sizeof(float));
+    if(!snakes || !bodySegments || !hiddenScratch || !visionBuffer || !roiBuffer || !visionScratch || !generationFitness
+        || initNetworkArena(&populations[0], config.snakeCount, num_input, num_hidden1, num_output)
+        || initNetworkArena(&populations[1], config.snakeCount, num_input, num_hidden1, num_output)
+        || initWorld(&world, config.gridSize) || initSnapshotExchange(&exchange, config.snakeCount)){
+        fprintf(stderr, "Could not allocate world and population\n");
+        return 1;
+    }
+    if(config.arenaSize && startArenas()) return 1;
+    if(config.telemetryPath[0] && openTelemetry(&runLog, config.telemetryPath)) return 1;
+    if(startCheckpointWriter(&checkpoints, config.checkpointPath, config.checkpointKeep)){
+        fprintf(stderr, "Could not start checkpoint writer\n");
+        return 1;
+    }
+    for(int s = 0; s < config.snakeCount; s++) snakes[s].body = bodySegments + (size_t)s * config.maxLength;
+    beginReplayTick(&replay); // the initial food spawns belong to the first tick
     spawnWalls();
     spawnFoods();
-    initializeSnakes();
-
-    int running = 1;
-    while(running){
-        handleEvents(&running);
-        updateGameLogic();
-        if(rendering){
-            renderGame(renderer, font);
-            SDL_Delay(10);
-        }
+    if(initializeSnakes() && !config.arenaSize){
+        fprintf(stderr, "Could not place every snake: the central 75%% of the grid has no empty cell left\n");
+        return 1;
     }
+    checkReplayWeights(&replay, hashNetworks(populations[currentPopulation].networks, config.snakeCount));
 
+    SDL_AtomicSet(&simRunning, 1);
+    if(config.headless){
+        // no window: the simulation runs on this thread until ticks or the replay run out
+        startAllocReport();
+        while(simulateTick());
+    }else{
+        if(initRenderLayers(renderer, font)) return 1;
+        startAllocReport();
+        SDL_Thread* simThread = SDL_CreateThread(runSimulation, "simulation", NULL);
+        if(!simThread){
+            fprintf(stderr, "Could not start simulation thread: %s\n", SDL_GetError());
+            return 1;
+        }
+
+        // render thread: consume the newest snapshot at display rate, never block the sim
+        const WorldSnapshot* view = NULL;
+        int running = 1;
+        while(running){
+            handleEvents(&running);
+            WorldSnapshot* latest = acquireSnapshot(&exchange);
+            if(latest){
+                applyCellChanges(latest);
+                view = latest;
+            }
+            if(rendering && view) renderGame(renderer, view);
+            SDL_Delay(RENDER_DELAY);
+        }
+        SDL_AtomicSet(&simRunning, 0);
+        SDL_WaitThread(simThread, NULL);
+    }
+    printAllocReport(); // before shutdown frees anything
+    closeTelemetry(&runLog);
+    stopCheckpointWriter(&checkpoints);
+    printCheckpointStats(&checkpoints);
+    printCullStats();
+    stopArenas();
+    bool replayFailed = finishReplay(&replay);
 
     // cleanup
-    for(int s = 0; s < SNAKE_COUNT; s++){
-        cleanupNeuralNetwork(&snakes[s].brain);
+    cleanupNetworkArena(&populations[0]);
+    cleanupNetworkArena(&populations[1]);
+    statFree(ALLOC_SNAKES, snakes, config.snakeCount * sizeof(Snake));
+    statFree(ALLOC_SNAKES, bodySegments, (size_t)config.snakeCount * config.maxLength * sizeof(Point));
+    statFree(ALLOC_SNAKES, visionBuffer, num_input * sizeof(float));
+    statFree(ALLOC_SNAKES, roiBuffer, (size_t)config.searchSize * config.searchSize * sizeof(float));
+    statFree(ALLOC_SNAKES, visionScratch, (visionScratchSize(&visionEncoder) + 1) * sizeof(float));
+    statFree(ALLOC_SNAKES, hiddenScratch, num_hidden1 * sizeof(float));
+    statFree(ALLOC_SNAKES, generationFitness, config.snakeCount * sizeof(float));
+    statFree(ALLOC_FOOD, foodArray, foodCapacity * sizeof(Point));
+    freeWorld(&world);
+    destroySnapshotExchange(&exchange);
+    if(!config.headless){
+        cleanupRenderLayers();
+        TTF_CloseFont(font);
+        SDL_DestroyRenderer(renderer);
+        SDL_DestroyWindow(window);
+        TTF_Quit();
+        SDL_Quit();
+    }
+    return replayFailed;
+}
+
+// record: write the run's seed and settings; replay: take them from the log
+bool startReplay(){
+    ReplayHeader header = {0};
+    if(config.replayPath[0]){
+        if(openReplay(&replay, config.replayPath, config.replayTolerance)) return true;
+        header = replay.header;
+        if(header.numHidden != num_hidden1){
+            fprintf(stderr, "Replay log was recorded with %d hidden neurons, this build has %d\n", header.numHidden, num_hidden1);
+            return true;
+        }
+        config.seed = (int)header.seed;
+        config.gridSize = header.gridSize;
+        config.snakeCount = header.snakeCount;
+        config.foodCount = header.foodCount;
+        config.searchSize = header.searchSize;
+        config.fovea = header.fovea;
+        config.visionRings = header.visionRings;
+        config.maxLength = header.maxLength;
+        config.generationTicks = header.generationTicks;
+        config.cullIdle = header.cullIdle;
+        config.cullStagnant = header.cullStagnant;
+        config.cullMargin = header.cullMargin;
+        config.cullGrace = header.cullGrace;
+        config.cullRespawn = header.cullRespawn;
+        config.arenaSize = header.arenaSize;
+        config.arenaTicks = header.arenaTicks;
+        config.arenaFood = header.arenaFood;
+        mutationRate = header.mutationRate;
+        mutationMagnitude = header.mutationMagnitude;
+        return validateConfig(&config);
+    }
+    if(config.recordPath[0]){
+        header.seed = (uint32_t)config.seed;
+        header.gridSize = config.gridSize;
+        header.snakeCount = config.snakeCount;
+        header.foodCount = config.foodCount;
+        header.searchSize = config.searchSize;
+        header.fovea = config.fovea;
+        header.visionRings = config.visionRings;
+        header.maxLength = config.maxLength;
+        header.generationTicks = config.generationTicks;
+        header.cullIdle = config.cullIdle;
+        header.cullStagnant = config.cullStagnant;
+        header.cullMargin = config.cullMargin;
+        header.cullGrace = config.cullGrace;
+        header.cullRespawn = config.cullRespawn;
+        header.arenaSize = config.arenaSize;
+        header.arenaTicks = config.arenaTicks;
+        header.arenaFood = config.arenaFood;
+        header.numHidden = num_hidden1;
+        header.mutationRate = mutationRate;
+        header.mutationMagnitude = mutationMagnitude;
+        return startRecording(&replay, config.recordPath, &header);
+    }
+    return false;
+}
+
+int runSimulation(void* data){
+    (void)data;
+    while(SDL_AtomicGet(&simRunning) && simulateTick()){
+        if(snapshotConsumed(&exchange)) publishWorldState();
     }
-    TTF_CloseFont(font);
-    SDL_DestroyRenderer(renderer);
-    SDL_DestroyWindow(window);
-    TTF_Quit();
-    SDL_Quit();
     return 0;
 }
 
-void initializeGrid(){
-    for (int i = 0; i < GRID_SIZE; i++)
-        for (int j = 0; j < GRID_SIZE; j++)
-            grid[i][j] = EMPTY_VALUE;
+// one step of the world; false once the tick limit is reached or a replay has ended or diverged
+bool simulateTick(){
+    static Uint32 lastRateTime = 0;
+    static unsigned long lastRateTicks = 0;
+    static Uint32 lastAllocReportTime = 0;
+    if(simTicks == 0) lastRateTime = lastAllocReportTime = SDL_GetTicks();
+
+    unsigned long long allocations = allocationCount();
+    handleCommands();
+    updateGameLogic();
+    endReplayTick(&replay);
+    simTicks++;
+    if(allocationCount() != allocations) allocatingTicks++;
+
+    Uint32 now = SDL_GetTicks();
+    if(now - lastRateTime >= 1000){
+        ticksPerSecond = (simTicks - lastRateTicks) * 1000.0f / (now - lastRateTime);
+        lastRateTime = now;
+        lastRateTicks = simTicks;
+    }
+    if(config.allocReport && now - lastAllocReportTime >= (Uint32)config.allocReport * 1000){
+        reportAllocations();
+        lastAllocReportTime = now;
+    }
+    if(config.ticks && simTicks >= (unsigned long)config.ticks) return false;
+    return beginReplayTick(&replay);
 }
 
+// a replay takes its commands from the log, live input is dropped
+void handleCommands(){
+    SimCommand cmd;
+    int recorded;
+    while(pollCommand(&commands, &cmd)){
+        if(replay.mode == REPLAY_VERIFY) continue;
+        recordReplayCommand(&replay, cmd);
+        applyCommand(cmd);
+    }
+    while(nextReplayCommand(&replay, &recorded)) applyCommand((SimCommand)recorded);
+}
+
+void applyCommand(SimCommand cmd){
+    switch(cmd){
+        case CMD_RATE_UP: mutationRate += 0.01; break;
+        case CMD_RATE_DOWN: mutationRate = MAX(0, mutationRate - 0.01); break;
+        case CMD_MAGNITUDE_UP: mutationMagnitude += 0.01; break;
+        case CMD_MAGNITUDE_DOWN: mutationMagnitude = MAX(0, mutationMagnitude - 0.01); break;
+        case CMD_SAVE: manageNeuralNetworks('s'); break;
+        case CMD_LOAD: manageNeuralNetworks('l'); break;
+        case CMD_EVOLVE: evolveSnakes(); break;
+        case CMD_MUTATE:
+            for (int s = 0; s < config.snakeCount; s++){
+                mutateNeuralNetwork(snakes[s].brain, mutationRate, mutationMagnitude);
+            }
+            break;
+    }
+}
+
+void publishWorldState(){
+    WorldSnapshot* snap = exchange.back;
+    snap->tick = simTicks;
+    snap->evolutionEvents = evolutionEvents;
+    snap->mutationRate = mutationRate;
+    snap->mutationMagnitude = mutationMagnitude;
+    snap->ticksPerSecond = ticksPerSecond;
+    for(int s = 0; s < config.snakeCount; s++){
+        snap->snakes[s].x = snakes[s].position.x;
+        snap->snakes[s].y = snakes[s].position.y;
+        snap->snakes[s].foodsEaten = snakes[s].foodsEaten;
+    }
+    publishSnapshot(&exchange);
+}
 
 bool checkSnakeOnFood(int x, int y){
-    return grid[y][x] == FOOD_VALUE;
+    return worldGet(&world, x, y) == FOOD_VALUE;
 }
 
 
 void updateGameLogic(){
-    static int lastEvolveTime = 0;
-    int currentTime = SDL_GetTicks();
-
-    if(currentTime - lastEvolveTime >= EVOLVE_TIME){
+    if(config.arenaSize){
+        evolveSnakes(); // every tick scores and breeds one generation, the shared world is only a view
+        return;
+    }
+    if(aliveSnakes < MIN(2, placedSnakes)){
+        evolveSnakes(); // everyone but the leader was culled, the generation is decided
+    }else if(config.generationTicks){
+        if(simTicks - generationStartTick >= (unsigned long)config.generationTicks) evolveSnakes();
+    }else if(SDL_GetTicks() - generationStartTime >= (Uint32)config.evolveTime){
         evolveSnakes();
-        lastEvolveTime = currentTime;
     }
 
-    for(int s = 0; s < SNAKE_COUNT; s++){
-        int x = snakes[s].position.x;
-        int y = snakes[s].position.y;
-        if(checkSnakeOnFood(x,y)){
-            eatFood(x,y);
-            spawnFoods();
-            snakes[s].foodsEaten++;
-            snakes[s].actionsSinceLastFood = 0;
+    for(int s = 0; s < config.snakeCount; s++){
+        if(snakes[s].culled){
+            generationCulls.skippedSnakeTicks++;
+            continue;
         }
-        processSnake(s);
+        evaluatedSnakeTicks++;
+        snakes[s].idleTicks = processSnake(s) ? 0 : snakes[s].idleTicks + 1;
+        snakes[s].ticksSinceFood++;
         if(snakes[s].actionsSinceLastFood++ > 25){
-            mutateNeuralNetwork(&snakes[s].brain, mutationRate, mutationMagnitude);
+            mutateNeuralNetwork(snakes[s].brain, mutationRate, mutationMagnitude);
             snakes[s].actionsSinceLastFood = 0;
         }
+
+        if(config.cullIdle && snakes[s].idleTicks >= config.cullIdle){
+            cullSnake(s, &generationCulls.idle);
+        }else if(config.cullStagnant && snakes[s].ticksSinceFood >= config.cullStagnant){
+            cullSnake(s, &generationCulls.stagnant);
+        }else if(config.cullMargin && s != leaderIndex && simTicks - snakes[s].startTick >= (unsigned long)config.cullGrace
+            && leaderFoods - snakes[s].foodsEaten >= config.cullMargin){
+            cullSnake(s, &generationCulls.dominated);
+        }
     }
 }
 
-void initializeSnakes(){
-    for(int s = 0; s < SNAKE_COUNT; s++){
-        int rectWidth = (int)(GRID_SIZE * 0.75);
-        int rectHeight = (int)(GRID_SIZE * 0.75);
+bool cullingEnabled(){
+    return config.cullIdle || config.cullStagnant || config.cullMargin;
+}
 
-        int minX = (int)((GRID_SIZE - rectWidth) / 2);
-        int minY = (int)((GRID_SIZE - rectHeight) / 2);
+// stops evaluating snake s for the rest of the generation, or with cull-respawn
+// hands its slot to a mutated copy of the leader starting from scratch
+void cullSnake(int s, uint32_t* reason){
+    (*reason)++;
+    if(!config.cullRespawn){
+        snakes[s].culled = true;
+        aliveSnakes--;
+        clearBody(s);
+        return;
+    }
+    generationCulls.respawned++;
+    if(leaderIndex >= 0 && leaderIndex != s) copyNeuralNetwork(snakes[leaderIndex].brain, snakes[s].brain);
+    mutateNeuralNetwork(snakes[s].brain, mutationRate, mutationMagnitude);
+    if(!placeSnake(s)){ // no room for the offspring, sit out the generation
+        snakes[s].culled = true;
+        aliveSnakes--;
+    }
+    if(s == leaderIndex) findLeader();
+}
 
-        snakes[s].position.x = minX + rand() % rectWidth;
-        snakes[s].position.y = minY + rand() % rectHeight;
+void findLeader(){
+    leaderIndex = -1;
+    leaderFoods = 0;
+    for(int s = 0; s < config.snakeCount; s++){
+        if(snakes[s].foodsEaten > leaderFoods){
+            leaderFoods = snakes[s].foodsEaten;
+            leaderIndex = s;
+        }
+    }
+}
 
-        snakes[s].touchWall = false;
-        snakes[s].foodsEaten = 0;
-        snakes[s].actionsSinceLastFood = 0;
+bool startArenas(){
+    int threads = config.arenaThreads ? config.arenaThreads : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    arenaCount = MAX(1, MIN(threads, config.snakeCount));
+    arenas = (Arena*)statCalloc(ALLOC_ARENAS, arenaCount, sizeof(Arena));
+    if(!arenas || initThreadPool(&arenaPool, arenaCount)){
+        fprintf(stderr, "Could not start %d arena threads\n", arenaCount);
+        return true;
+    }
+    for(int a = 0; a < arenaCount; a++){
+        if(initArena(&arenas[a], config.arenaSize, config.arenaFood, config.maxLength, &visionEncoder, num_hidden1)){
+            fprintf(stderr, "Could not allocate arenas\n");
+            return true;
+        }
+    }
+    return false;
+}
+
+// task index owns arenas[index] and scores every arenaCount-th snake, so results
+// do not depend on which thread picks up which task
+void evaluateArenaShard(void* ctx, int index){
+    (void)ctx;
+    for(int s = index; s < config.snakeCount; s += arenaCount){
+        generationFitness[s] = (float)evaluateArena(&arenas[index], snakes[s].brain, arenaSeed, config.arenaTicks);
+    }
+}
+
+void evaluateArenas(){
+    Uint64 start = SDL_GetPerformanceCounter();
+    arenaSeed = (unsigned int)config.seed ^ ((unsigned int)evolutionEvents * 2654435761u);
+    runThreadPool(&arenaPool, arenaCount, evaluateArenaShard, NULL);
+    arenaEvaluations += config.snakeCount;
+    arenaSeconds += (double)(SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+}
+
+void stopArenas(){
+    if(!arenas) return;
+    if(arenaEvaluations){
+        printf("Scored %lu brains in %d %dx%d arena%s: %.0f arena ticks/sec\n", arenaEvaluations,
+               arenaCount, config.arenaSize, config.arenaSize, arenaCount == 1 ? "" : "s", arenaSeconds > 0 ? arenaEvaluations * config.arenaTicks / arenaSeconds : 0.0);
+    }
+    destroyThreadPool(&arenaPool);
+    for(int a = 0; a < arenaCount; a++) freeArena(&arenas[a]);
+    statFree(ALLOC_ARENAS, arenas, arenaCount * sizeof(Arena));
+    arenas = NULL;
+}
+
+void printCullStats(){
+    if(!cullingEnabled()) return;
+    unsigned long total = evaluatedSnakeTicks + totalCulls.skippedSnakeTicks + generationCulls.skippedSnakeTicks;
+    printf("Culled %u idle, %u stagnant and %u dominated snakes (%u respawned), skipped %llu of %lu snake ticks (%.1f%%)\n",
+           totalCulls.idle + generationCulls.idle, totalCulls.stagnant + generationCulls.stagnant,
+           totalCulls.dominated + generationCulls.dominated, totalCulls.respawned + generationCulls.respawned,
+           (unsigned long long)(totalCulls.skippedSnakeTicks + generationCulls.skippedSnakeTicks), total,
+           total ? 100.0 * (totalCulls.skippedSnakeTicks + generationCulls.skippedSnakeTicks) / total : 0.0);
+}
+
+// after startup, so per tick rates cover only the running simulation
+void startAllocReport(){
+    if(!config.allocReport) return;
+    readAllocStats(allocStart);
+    memcpy(allocLastReport, allocStart, sizeof(allocStart));
+    allocStartTick = allocLastReportTick = simTicks;
+    AllocCounter* total = &allocStart[ALLOC_SUBSYSTEMS];
+    double perSnake = (double)(allocStart[ALLOC_SNAKES].live + allocStart[ALLOC_NETWORKS].live) / config.snakeCount;
+    printf("Startup memory: %.1f MiB live (peak %.1f MiB), %.0f bytes per snake for its networks and buffers\n",
+           total->live / 1048576.0, total->peak / 1048576.0, perSnake);
+}
+
+// one line per interval; subsystems that allocated are listed with their rate
+void reportAllocations(){
+    AllocCounter now[ALLOC_SUBSYSTEMS + 1];
+    readAllocStats(now);
+    unsigned long ticks = simTicks - allocLastReportTick;
+    char breakdown[256] = "";
+    int used = 0;
+    for(int i = 0; i < ALLOC_SUBSYSTEMS && used < (int)sizeof(breakdown); i++){
+        unsigned long long allocations = now[i].allocations - allocLastReport[i].allocations;
+        if(allocations) used += snprintf(breakdown + used, sizeof(breakdown) - used, " %s %.3g", allocSubsystemName((AllocSubsystem)i), ticks ? (double)allocations / ticks : 0.0);
+    }
+    AllocCounter* total = &now[ALLOC_SUBSYSTEMS];
+    printf("Tick %lu: %.1f MiB live (peak %.1f MiB), %lu of %lu ticks allocated%s%s\n", simTicks, total->live / 1048576.0,
+           total->peak / 1048576.0, allocatingTicks - allocLastReportAllocatingTicks, ticks, breakdown[0] ? ", allocations/tick:" : "", breakdown);
+    memcpy(allocLastReport, now, sizeof(now));
+    allocLastReportTick = simTicks;
+    allocLastReportAllocatingTicks = allocatingTicks;
+}
+
+void printAllocReport(){
+    if(!config.allocReport) return;
+    unsigned long ticks = simTicks - allocStartTick;
+    printf("Allocations over %lu ticks, %lu of which allocated:\n", ticks, allocatingTicks);
+    printAllocStats(stdout, allocStart, ticks);
+}
+
+// returns the number of snakes that found no room and sit out the generation
+int initializeSnakes(){
+    int unplaced = 0;
+    aliveSnakes = config.snakeCount;
+    leaderIndex = -1;
+    leaderFoods = 0;
+    for(int s = 0; s < config.snakeCount; s++){
+        snakes[s].culled = !placeSnake(s);
+        if(snakes[s].culled){
+            aliveSnakes--;
+            unplaced++;
+        }
 
         if(!snakes[s].firstInit){
-            initializeNetwork(&snakes[s].brain, num_input, num_hidden1, num_output);
+            snakes[s].brain = &populations[currentPopulation].networks[s];
             snakes[s].firstInit = true;
-            saveLoadNetwork(&snakes[s].brain, "weights.csv", 'l');
+            saveLoadNetwork(snakes[s].brain, visionWeightsFile(&visionEncoder), 'l');
         }
 
-        mutateNeuralNetwork(&snakes[s].brain, mutationRate, mutationMagnitude);
+        mutateNeuralNetwork(snakes[s].brain, mutationRate, mutationMagnitude);
+    }
+    placedSnakes = config.snakeCount - unplaced;
+    return unplaced;
+}
+
+// random empty start inside the central 75% of the grid, one segment long with fresh counters;
+// false, with counters reset and no body, if that area has no empty cell
+bool placeSnake(int s){
+    int rectWidth = (int)(config.gridSize * 0.75);
+    int rectHeight = (int)(config.gridSize * 0.75);
+
+    int minX = (int)((config.gridSize - rectWidth) / 2);
+    int minY = (int)((config.gridSize - rectHeight) / 2);
+
+    clearBody(s);
+    snakes[s].touchWall = false;
+    snakes[s].foodsEaten = 0;
+    snakes[s].actionsSinceLastFood = 0;
+    snakes[s].ticksSinceFood = 0;
+    snakes[s].idleTicks = 0;
+    snakes[s].startTick = simTicks;
+
+    int x, y, attempts = 0;
+    do{
+        x = minX + rand() % rectWidth;
+        y = minY + rand() % rectHeight;
+    }while(worldGet(&world, x, y) != EMPTY_VALUE && ++attempts < PLACE_ATTEMPTS);
+    // crowded: scan the area row by row from the last random cell
+    for(int i = 0; i < rectWidth * rectHeight && worldGet(&world, x, y) != EMPTY_VALUE; i++){
+        if(++x == minX + rectWidth){
+            x = minX;
+            if(++y == minY + rectHeight) y = minY;
+        }
     }
+    if(worldGet(&world, x, y) != EMPTY_VALUE) return false;
+
+    snakes[s].position.x = x;
+    snakes[s].position.y = y;
+    snakes[s].body[0] = snakes[s].position;
+    snakes[s].bodyHead = 0;
+    snakes[s].length = 1;
+    setCell(x, y, BODY_VALUE);
+    return true;
 }
 
 void evolveSnakes(){
     int bestSnakeIndex = 0;
     int maxFoodEaten = 0;
     evolutionEvents++;
-    for(int s = 0; s < SNAKE_COUNT; s++){
+    if(config.arenaSize) evaluateArenas();
+    for(int s = 0; s < config.snakeCount; s++){
+        if(!config.arenaSize) generationFitness[s] = (float)snakes[s].foodsEaten;
         //if(!snakes[s].touchWall && snakes[s].foodsEaten > maxFoodEaten){
-        if(snakes[s].foodsEaten > maxFoodEaten){
-            maxFoodEaten = snakes[s].foodsEaten;
+        if((int)generationFitness[s] > maxFoodEaten){
+            maxFoodEaten = (int)generationFitness[s];
             bestSnakeIndex = s;
         }
         snakes[s].foodsEaten = 0;
     }
 
-    for(int s = 0; s < SNAKE_COUNT; s++){
-        if(s != bestSnakeIndex){
-            if(maxFoodEaten != 0){
-                copyNeuralNetwork(&snakes[bestSnakeIndex].brain, &snakes[s].brain);
-            }else{
-                mutateNeuralNetwork(&snakes[s].brain, mutationRate, mutationMagnitude);
-            }
+    GenerationRecord record = { simTicks, (uint32_t)evolutionEvents, (uint32_t)config.snakeCount,
+        maxFoodEaten != 0 ? bestSnakeIndex : -1, mutationRate, mutationMagnitude, ticksPerSecond };
+    logGeneration(&runLog, &record, generationFitness);
+    replayGeneration(&replay, (uint32_t)evolutionEvents, generationFitness);
+    if(cullingEnabled()){
+        generationCulls.generation = (uint32_t)evolutionEvents;
+        logCulling(&runLog, &generationCulls);
+        totalCulls.idle += generationCulls.idle;
+        totalCulls.stagnant += generationCulls.stagnant;
+        totalCulls.dominated += generationCulls.dominated;
+        totalCulls.respawned += generationCulls.respawned;
+        totalCulls.skippedSnakeTicks += generationCulls.skippedSnakeTicks;
+        memset(&generationCulls, 0, sizeof(generationCulls));
+    }
+    generationStartTick = simTicks;
+    generationStartTime = SDL_GetTicks();
+    if(config.checkpointEvery && evolutionEvents % config.checkpointEvery == 0){
+        submitCheckpoint(&checkpoints, populations[currentPopulation].networks, config.snakeCount, simTicks, evolutionEvents, (uint32_t)config.seed);
+    }
+
+    // children are written straight into the spare population, then the buffers swap
+    NetworkArena* children = &populations[1 - currentPopulation];
+    for(int s = 0; s < config.snakeCount; s++){
+        NeuralNetwork* child = &children->networks[s];
+        if(s != bestSnakeIndex && maxFoodEaten != 0){
+            copyNeuralNetwork(snakes[bestSnakeIndex].brain, child);
+            if(config.arenaSize) mutateNeuralNetwork(child, mutationRate, mutationMagnitude);
+        }else{
+            copyNeuralNetwork(snakes[s].brain, child);
+            if(s != bestSnakeIndex) mutateNeuralNetwork(child, mutationRate, mutationMagnitude);
         }
     }
+    currentPopulation = 1 - currentPopulation;
+    for(int s = 0; s < config.snakeCount; s++){
+        snakes[s].brain = &children->networks[s];
+    }
 
-    initializeSnakes();
+    // arenas score the children exactly as bred, the shared world neither moves nor mutates them
+    if(!config.arenaSize) initializeSnakes();
 }
 
 bool snakeTakeAction(int s, Action act){ // true if good action
@@ -234,7 +752,7 @@ bool snakeTakeAction(int s, Action act){ // true if good action
     int new_y = y;
     switch(act){
         case DO_NOTHING:
-            //mutateNeuralNetwork(&snakes[s].brain, mutationRate, mutationMagnitude);
+            //mutateNeuralNetwork(snakes[s].brain, mutationRate, mutationMagnitude);
             return 0;
             break;
         case GO_UP:    new_y--; break;
@@ -242,70 +760,107 @@ bool snakeTakeAction(int s, Action act){ // true if good action
         case GO_LEFT:  new_x--; break;
         case GO_RIGHT: new_x++; break;
     }
-    if(checkMoveValid(new_x, new_y)){
-        snakes[s].position.x = new_x;
-        snakes[s].position.y = new_y;
+    if(checkMoveValid(new_x, new_y) && worldGet(&world, new_x, new_y) != BODY_VALUE){
+        bool food = checkSnakeOnFood(new_x, new_y);
+        if(food){
+            replayFood(&replay, FRAME_EAT, s, new_x, new_y);
+            eatFood(new_x, new_y);
+        }
+        moveSnake(s, new_x, new_y, food);
+        if(food) feedSnake(s);
         return 1;
     }else{
-        snakes[s].touchWall = true;
+        snakes[s].touchWall = true; // walls and bodies alike
         return 0;
     }
 }
 
-void extractROI(float vision[], int x, int y){
-    memset(vision, 0, SRCH_SIZE * SRCH_SIZE * sizeof(float));
-    int box_x_start = (int)MAX(0, x - SRCH_SIZE / 2.0);
-    int box_x_end   = (int)MIN(GRID_SIZE - 1, x + SRCH_SIZE / 2.0);
-    int box_y_start = (int)MAX(0, y - SRCH_SIZE / 2.0);
-    int box_y_end   = (int)MIN(GRID_SIZE - 1, y + SRCH_SIZE / 2.0);
+// pushes the head onto the ring buffer; the tail cell is freed unless the snake grows
+void moveSnake(int s, int x, int y, bool grow){
+    Snake* snake = &snakes[s];
+    if(!grow || snake->length == config.maxLength){
+        Point tail = snake->body[(snake->bodyHead - snake->length + 1 + config.maxLength) % config.maxLength];
+        setCell(tail.x, tail.y, EMPTY_VALUE);
+    }else{
+        snake->length++;
+    }
+    snake->bodyHead = (snake->bodyHead + 1) % config.maxLength;
+    snake->body[snake->bodyHead].x = x;
+    snake->body[snake->bodyHead].y = y;
+    snake->position = snake->body[snake->bodyHead];
+    setCell(x, y, BODY_VALUE);
+}
 
-    //int x_diff = x - (int)(SRCH_SIZE / 2.0);
-    //int y_diff = y - (int)(SRCH_SIZE / 2.0);
+void clearBody(int s){
+    Snake* snake = &snakes[s];
+    for(int i = 0; i < snake->length; i++){
+        Point p = snake->body[(snake->bodyHead - i + config.maxLength) % config.maxLength];
+        setCell(p.x, p.y, EMPTY_VALUE);
+    }
+    snake->length = 0;
+}
 
-    int vision_index = 0;
+void setCell(int x, int y, float value){
+    float previous = worldGet(&world, x, y);
+    worldSet(&world, x, y, value);
+    if(!config.headless) recordCellChange(&exchange, x, y, previous, value);
+}
 
-    for (int i = box_y_start; i < box_y_end; i++){
-        for (int j = box_x_start; j < box_x_end; j++){
-            vision[vision_index] = grid[i][j];
-            vision_index++;
-        }
+// called after the move onto the food, so replacement food avoids the new head
+void feedSnake(int s){
+    spawnFoods();
+    snakes[s].foodsEaten++;
+    snakes[s].actionsSinceLastFood = 0;
+    snakes[s].ticksSinceFood = 0;
+    if(snakes[s].foodsEaten > leaderFoods){
+        leaderFoods = snakes[s].foodsEaten;
+        leaderIndex = s;
     }
 }
 
+// row-major searchSize x searchSize window centred on (x, y), encoded the same way as sim.c's input
+void extractROI(float vision[], int x, int y){
+    int half = config.searchSize / 2;
+    if(!visionEncoder.fovea){
+        worldReadWindow(&world, vision, x - half, y - half, config.searchSize, config.searchSize);
+        return;
+    }
+    worldReadWindow(&world, roiBuffer, x - half, y - half, config.searchSize, config.searchSize);
+    encodeVision(&visionEncoder, roiBuffer, vision, visionScratch);
+}
 
-void processSnake(int s){
-    float vision[SRCH_SIZE*SRCH_SIZE] = {0.0f};
 
+bool processSnake(int s){ // true if the snake moved
     int x = snakes[s].position.x;
     int y = snakes[s].position.y;
 
-    extractROI(vision, x, y);
-
-    forwardPropagation(&snakes[s].brain, vision);
-
-    float output[5];
-    for (int i = 0; i < 5; i++)
-        output[i] = snakes[s].brain.output_layer.neurons[i].output;
+    extractROI(visionBuffer, x, y);
 
-    Action agentAction = (Action)(max_element_index(output, 5));
+    Action agentAction = (Action)replayAction(&replay, s, inferAction(snakes[s].brain, visionBuffer, hiddenScratch));
 
     if(!snakeTakeAction(s, agentAction)){
-        mutateNeuralNetwork(&snakes[s].brain, mutationRate, mutationMagnitude);
+        mutateNeuralNetwork(snakes[s].brain, mutationRate, mutationMagnitude);
+        return false;
     }
+    return true;
 }
 
 bool checkMoveValid(int x, int y){ // true if valid
-    const int WALL_END = GRID_SIZE - WALL_SHIFT;
-    return !(x < 0 || y < 0 || x >= GRID_SIZE || y >= GRID_SIZE || x == WALL_SHIFT || y == WALL_SHIFT || x >= WALL_END || y >= WALL_END);
+    const int WALL_END = config.gridSize - WALL_SHIFT;
+    return !(x < 0 || y < 0 || x >= config.gridSize || y >= config.gridSize || x == WALL_SHIFT || y == WALL_SHIFT || x >= WALL_END || y >= WALL_END);
 }
 
 void pushFood(int x, int y){
-    foodExisting++;
-    foodArray = (Point*)realloc(foodArray, foodExisting * sizeof(Point));
-    if (foodArray == NULL){
-        perror("Memory allocation error");
-        exit(1);
+    if (foodExisting == foodCapacity){
+        int capacity = MAX(foodCapacity * 2, MAX(config.foodCount, 16));
+        foodArray = (Point*)statRealloc(ALLOC_FOOD, foodArray, foodCapacity * sizeof(Point), capacity * sizeof(Point));
+        if (foodArray == NULL){
+            perror("Memory allocation error");
+            exit(1);
+        }
+        foodCapacity = capacity;
     }
+    foodExisting++;
     foodArray[foodExisting - 1].x = x;
     foodArray[foodExisting - 1].y = y;
 }
@@ -318,130 +873,219 @@ Point popFood(){
 
     Point poppedFood = foodArray[foodExisting - 1];
     foodExisting--;
-
-    if (foodExisting == 0){
-        free(foodArray);
-        foodArray = NULL;
-    } else {
-        foodArray = (Point*)realloc(foodArray, foodExisting * sizeof(Point));
-        if (foodArray == NULL){
-            perror("Memory allocation error");
-            exit(1);
-        }
-    }
     return poppedFood;
 }
 
 void eatFood(int x, int y){
     popFood(x,y);
-    grid[y][x] = EMPTY_VALUE;
-    isFoodChanged = true;
+    worldSet(&world, x, y, EMPTY_VALUE);
+    if(!config.headless) recordCellChange(&exchange, x, y, FOOD_VALUE, EMPTY_VALUE);
 }
 
 void spawnFood(int x, int y){
+    float previous = worldGet(&world, x, y);
+    replayFood(&replay, FRAME_SPAWN, -1, x, y);
     pushFood(x,y);
-    grid[y][x] = FOOD_VALUE;
-    isFoodChanged = true;
+    worldSet(&world, x, y, FOOD_VALUE);
+    if(previous != FOOD_VALUE && !config.headless) recordCellChange(&exchange, x, y, previous, FOOD_VALUE);
 }
 
 void spawnFoods(){
-    #define RANDOM_COORD() (WALL_SHIFT + 1 + rand() % (GRID_SIZE - 2 - WALL_SHIFT))
-    for(int i = foodExisting; i < FOOD_COUNT; i++){
-        spawnFood(RANDOM_COORD(),RANDOM_COORD());
+    #define RANDOM_COORD() (WALL_SHIFT + 1 + rand() % (config.gridSize - 2 - WALL_SHIFT))
+    while(foodExisting < config.foodCount){
+        int x = RANDOM_COORD();
+        int y = RANDOM_COORD();
+        if(worldGet(&world, x, y) != BODY_VALUE) spawnFood(x, y); // never under a snake
     }
 }
 
 void spawnWalls(){
-    int size = GRID_SIZE-WALL_SHIFT;
+    int size = config.gridSize-WALL_SHIFT;
     for(int i = WALL_SHIFT; i < size; i++){
-        grid[WALL_SHIFT][i] = grid[size-1][i] = grid[i][WALL_SHIFT] = grid[i][size-1] = WALL_VALUE;
+        worldSet(&world, i, WALL_SHIFT, WALL_VALUE);
+        worldSet(&world, i, size-1, WALL_VALUE);
+        worldSet(&world, WALL_SHIFT, i, WALL_VALUE);
+        worldSet(&world, size-1, i, WALL_VALUE);
     }
 }
 
 
 
 
-void renderText(SDL_Renderer* renderer, TTF_Font* font, const char* text, int x, int y, SDL_Color textColor){
-    SDL_Surface* textSurface = TTF_RenderText_Solid(font, text, textColor);
-    SDL_Texture* textTexture = SDL_CreateTextureFromSurface(renderer, textSurface);
-    SDL_Rect textRect = { x, y, textSurface->w, textSurface->h };
-    SDL_RenderCopy(renderer, textTexture, NULL, &textRect);
-    SDL_FreeSurface(textSurface);
-    SDL_DestroyTexture(textTexture);
+void markCellChanged(int x, int y, float previous, float value){
+    int px = x / viewScale;
+    int py = y / viewScale;
+    int i = py * viewSize + px;
+    if(previous == FOOD_VALUE) foodCounts[i]--;
+    if(value == FOOD_VALUE) foodCounts[i]++;
+    if(previous == BODY_VALUE) bodyCounts[i]--;
+    if(value == BODY_VALUE) bodyCounts[i]++;
+    Uint32 pixel = bodyCounts[i] ? BODY_COLOR : foodCounts[i] ? FOOD_COLOR : 0;
+    if(pixel == foodPixels[i]) return;
+    foodPixels[i] = pixel;
+
+    if(foodTextureStale) return;
+    if(changedFoodCount == MAX_CHANGED_CELLS){
+        foodTextureStale = true; // too many patches, re-upload the whole layer instead
+        return;
+    }
+    changedFoodCells[changedFoodCount].x = px;
+    changedFoodCells[changedFoodCount].y = py;
+    changedFoodCount++;
 }
 
-bool stringChanged(const char* str1, const char* str2){
-    return strcmp(str1, str2) != 0;
+void applyCellChanges(const WorldSnapshot* view){
+    for (int i = 0; i < view->changeCount; i++){
+        const CellChange* c = &view->changes[i];
+        markCellChanged(c->x, c->y, c->previous, c->value);
+    }
 }
 
-void renderGame(SDL_Renderer* renderer, TTF_Font* font){
-    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-    SDL_RenderClear(renderer);
-    SDL_Color textColor = {255, 255, 255, 120};
-
-    // walls
-    if(!areWallsDrawn || DEBUGGING){
-        SDL_SetRenderDrawColor(renderer, 0, 0, 255, 150);
-        for (int i = 0; i < GRID_SIZE; i++){
-            for (int j = 0; j < GRID_SIZE; j++){
-                if (grid[i][j] == WALL_VALUE){
-                    SDL_Rect wallRect = { j, i, 1, 1 };
-                    SDL_RenderFillRect(renderer, &wallRect);
+// called before the sim thread starts, the only time the render side reads the world
+bool initRenderLayers(SDL_Renderer* renderer, TTF_Font* font){
+    size_t pixelCount = (size_t)viewSize * viewSize;
+    Uint32* wallPixels = (Uint32*)statCalloc(ALLOC_RENDER, pixelCount, sizeof(Uint32));
+    foodPixels = (Uint32*)statCalloc(ALLOC_RENDER, pixelCount, sizeof(Uint32));
+    foodCounts = (Uint16*)statCalloc(ALLOC_RENDER, pixelCount, sizeof(Uint16));
+    bodyCounts = (Uint16*)statCalloc(ALLOC_RENDER, pixelCount, sizeof(Uint16));
+    hudRows = MAX(0, MIN(config.snakeCount, (viewSize - 150) / 30));
+    counterLines = (TextLine*)statCalloc(ALLOC_RENDER, MAX(hudRows, 1), sizeof(TextLine));
+    if (!wallPixels || !foodPixels || !foodCounts || !bodyCounts || !counterLines){
+        fprintf(stderr, "Could not allocate render layers\n");
+        statFree(ALLOC_RENDER, wallPixels, pixelCount * sizeof(Uint32));
+        cleanupRenderLayers();
+        return true;
+    }
+
+    // only chunks that were ever written can hold walls, food or bodies
+    for (int cy = 0; cy < world.chunksPerSide; cy++){
+        for (int cx = 0; cx < world.chunksPerSide; cx++){
+            const float* chunk = worldChunk(&world, cx, cy);
+            if (!chunk) continue;
+            for (int i = 0; i < CHUNK_SIZE * CHUNK_SIZE; i++){
+                int x = (cx << CHUNK_SHIFT) + (i & CHUNK_MASK);
+                int y = (cy << CHUNK_SHIFT) + (i >> CHUNK_SHIFT);
+                if (!worldContains(&world, x, y)) continue;
+                int p = (y / viewScale) * viewSize + x / viewScale;
+                if (chunk[i] == WALL_VALUE) wallPixels[p] = WALL_COLOR;
+                if (chunk[i] == FOOD_VALUE){
+                    foodCounts[p]++;
+                    if (!bodyCounts[p]) foodPixels[p] = FOOD_COLOR;
+                }
+                if (chunk[i] == BODY_VALUE){
+                    bodyCounts[p]++;
+                    foodPixels[p] = BODY_COLOR;
                 }
             }
         }
     }
+    exchange.back->changeCount = 0; // already part of the scan
+
+    wallTexture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, viewSize, viewSize);
+    foodTexture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, viewSize, viewSize);
+    countAllocation(ALLOC_RENDER, textureBytes(wallTexture));
+    countAllocation(ALLOC_RENDER, textureBytes(foodTexture));
+    if (!wallTexture || !foodTexture){
+        fprintf(stderr, "Could not create render layers: %s\n", SDL_GetError());
+        statFree(ALLOC_RENDER, wallPixels, pixelCount * sizeof(Uint32));
+        cleanupRenderLayers();
+        return true;
+    }
+    SDL_Color textColor = {255, 255, 255, 255};
+    if (buildGlyphAtlas(&hudAtlas, renderer, font, textColor)){
+        statFree(ALLOC_RENDER, wallPixels, pixelCount * sizeof(Uint32));
+        cleanupRenderLayers();
+        return true;
+    }
+    SDL_UpdateTexture(wallTexture, NULL, wallPixels, viewSize * sizeof(Uint32));
+    statFree(ALLOC_RENDER, wallPixels, pixelCount * sizeof(Uint32));
+    SDL_SetTextureBlendMode(wallTexture, SDL_BLENDMODE_BLEND);
+    SDL_SetTextureBlendMode(foodTexture, SDL_BLENDMODE_BLEND);
+    foodTextureStale = true;
+    return false;
+}
 
-    // food
-    if(!isFoodDrawnInitial || DEBUGGING){
-        SDL_SetRenderDrawColor(renderer, 255, 0, 0, 255);
-        for (int i = 0; i < foodExisting; i++){
-            SDL_Rect foodRect = { foodArray[i].y, foodArray[i].x, 2, 2 };
-            SDL_RenderFillRect(renderer, &foodRect);
+void updateFoodTexture(){
+    if(foodTextureStale){
+        SDL_UpdateTexture(foodTexture, NULL, foodPixels, viewSize * sizeof(Uint32));
+        foodTextureStale = false;
+    }else{
+        for (int i = 0; i < changedFoodCount; i++){
+            Point c = changedFoodCells[i];
+            SDL_Rect cellRect = { c.x, c.y, 1, 1 };
+            SDL_UpdateTexture(foodTexture, &cellRect, &foodPixels[c.y * viewSize + c.x], viewSize * sizeof(Uint32));
         }
-        isFoodDrawnInitial = true;
     }
-    if(isFoodChanged){
-        SDL_SetRenderDrawColor(renderer, 255, 0, 0, 255);
-        SDL_Rect foodRect = { changedFoodCoord.y, changedFoodCoord.x, 2, 2 };
-        SDL_RenderFillRect(renderer, &foodRect);
-        isFoodChanged = false;
-    }
-    
+    changedFoodCount = 0;
+}
+
+void cleanupRenderLayers(){
+    size_t pixelCount = (size_t)viewSize * viewSize;
+    countFree(ALLOC_RENDER, textureBytes(wallTexture));
+    countFree(ALLOC_RENDER, textureBytes(foodTexture));
+    if (wallTexture) SDL_DestroyTexture(wallTexture);
+    if (foodTexture) SDL_DestroyTexture(foodTexture);
+    wallTexture = foodTexture = NULL;
+    destroyGlyphAtlas(&hudAtlas);
+    statFree(ALLOC_RENDER, foodPixels, pixelCount * sizeof(Uint32));
+    statFree(ALLOC_RENDER, foodCounts, pixelCount * sizeof(Uint16));
+    statFree(ALLOC_RENDER, bodyCounts, pixelCount * sizeof(Uint16));
+    statFree(ALLOC_RENDER, counterLines, MAX(hudRows, 1) * sizeof(TextLine));
+    foodPixels = NULL;
+    foodCounts = NULL;
+    bodyCounts = NULL;
+    counterLines = NULL;
+}
+
+// texture memory is owned by SDL and the driver, this is its pixel data only
+size_t textureBytes(SDL_Texture* texture){
+    Uint32 format;
+    int w, h;
+    if(!texture || SDL_QueryTexture(texture, &format, NULL, &w, &h) != 0) return 0;
+    return (size_t)w * h * SDL_BYTESPERPIXEL(format);
+}
+
+void renderGame(SDL_Renderer* renderer, const WorldSnapshot* view){
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+    SDL_RenderClear(renderer);
+
+    // static walls and incrementally patched food
+    updateFoodTexture();
+    SDL_RenderCopy(renderer, wallTexture, NULL, NULL);
+    SDL_RenderCopy(renderer, foodTexture, NULL, NULL);
+
     // snakes
     SDL_SetRenderDrawColor(renderer, 0, 255, 0, 255);
-    for (int s = 0; s < SNAKE_COUNT; s++){
-        SDL_Rect snakeRect = { snakes[s].position.x, snakes[s].position.y, 3, 3 };
+    for (int s = 0; s < view->snakeCount; s++){
+        SDL_Rect snakeRect = { view->snakes[s].x / viewScale, view->snakes[s].y / viewScale, 3, 3 };
         SDL_RenderFillRect(renderer, &snakeRect);
-
+    }
+    for (int s = 0; s < hudRows; s++){
         char counterText[32];
-        sprintf(counterText, "S%d: %d", s + 1, snakes[s].foodsEaten);
-        if (stringChanged(counterText, prevCounterText[s]) || DEBUGGING){
-            renderText(renderer, font, counterText, 10, 10 + (s * 30), textColor);
-            strcpy(prevCounterText[s], counterText);
-        }
+        sprintf(counterText, "S%d: %d", s + 1, view->snakes[s].foodsEaten);
+        setTextLine(&counterLines[s], &hudAtlas, counterText, 10, 10 + (s * 30));
+        drawTextLine(renderer, &hudAtlas, &counterLines[s]);
     }
 
     char evolutionEventsText[32];
-    sprintf(evolutionEventsText, "Evo: %d", evolutionEvents);
-    if (stringChanged(evolutionEventsText, prevEvolutionEventsText) || DEBUGGING){
-        renderText(renderer, font, evolutionEventsText, 10, GRID_SIZE - 90, textColor);
-        strcpy(prevEvolutionEventsText, evolutionEventsText);
-    }
+    sprintf(evolutionEventsText, "Evo: %d", view->evolutionEvents);
+    setTextLine(&evolutionEventsLine, &hudAtlas, evolutionEventsText, 10, viewSize - 90);
+    drawTextLine(renderer, &hudAtlas, &evolutionEventsLine);
 
     char mutationRateText[32];
-    sprintf(mutationRateText, "Mutation Rate: %.2f", mutationRate);
-    if (stringChanged(mutationRateText, prevMutationRateText) || DEBUGGING){
-        renderText(renderer, font, mutationRateText, 10, GRID_SIZE - 60, textColor);
-        strcpy(prevMutationRateText, mutationRateText);
-    }
+    sprintf(mutationRateText, "Mutation Rate: %.2f", view->mutationRate);
+    setTextLine(&mutationRateLine, &hudAtlas, mutationRateText, 10, viewSize - 60);
+    drawTextLine(renderer, &hudAtlas, &mutationRateLine);
 
     char mutationMagnitudeText[32];
-    sprintf(mutationMagnitudeText, "Mutation Magnitude %.2f", mutationMagnitude);
-    if (stringChanged(mutationMagnitudeText, prevMutationMagnitudeText) || DEBUGGING){
-        renderText(renderer, font, mutationMagnitudeText, 10, GRID_SIZE - 30, textColor);
-        strcpy(prevMutationMagnitudeText, mutationMagnitudeText);
-    }
+    sprintf(mutationMagnitudeText, "Mutation Magnitude %.2f", view->mutationMagnitude);
+    setTextLine(&mutationMagnitudeLine, &hudAtlas, mutationMagnitudeText, 10, viewSize - 30);
+    drawTextLine(renderer, &hudAtlas, &mutationMagnitudeLine);
+
+    char ticksPerSecondText[32];
+    sprintf(ticksPerSecondText, "Ticks/s: %.0f", view->ticksPerSecond);
+    setTextLine(&ticksPerSecondLine, &hudAtlas, ticksPerSecondText, 10, viewSize - 120);
+    drawTextLine(renderer, &hudAtlas, &ticksPerSecondLine);
 
     SDL_RenderPresent(renderer);
 }
@@ -454,18 +1098,14 @@ void handleEvents(int* running){
             *running = 0;
         } else if (e.type == SDL_KEYDOWN){
             switch (e.key.keysym.sym){
-                case SDLK_UP: mutationRate += 0.01; isTextChanged = true; break;
-                case SDLK_DOWN: mutationRate = MAX(0, mutationRate - 0.01); isTextChanged = true; break;
-                case SDLK_RIGHT: mutationMagnitude += 0.01; isTextChanged = true; break;
-                case SDLK_LEFT: mutationMagnitude = MAX(0, mutationMagnitude - 0.01); isTextChanged = true; break;
-                case SDLK_s: manageNeuralNetworks('s'); break;
-                case SDLK_l: manageNeuralNetworks('l'); break;
-                case SDLK_e: evolveSnakes(); break;
-                case SDLK_m:
-                    for (int s = 0; s < SNAKE_COUNT; s++){
-                        mutateNeuralNetwork(&snakes[s].brain, mutationRate, mutationMagnitude);
-                    }
-                    break;
+                case SDLK_UP: postCommand(&commands, CMD_RATE_UP); break;
+                case SDLK_DOWN: postCommand(&commands, CMD_RATE_DOWN); break;
+                case SDLK_RIGHT: postCommand(&commands, CMD_MAGNITUDE_UP); break;
+                case SDLK_LEFT: postCommand(&commands, CMD_MAGNITUDE_DOWN); break;
+                case SDLK_s: postCommand(&commands, CMD_SAVE); break;
+                case SDLK_l: postCommand(&commands, CMD_LOAD); break;
+                case SDLK_e: postCommand(&commands, CMD_EVOLVE); break;
+                case SDLK_m: postCommand(&commands, CMD_MUTATE); break;
                 case SDLK_q: *running = 0; break;
                 case SDLK_f: rendering = 0; break;
                 case SDLK_r: rendering = 1; break;
@@ -489,7 +1129,7 @@ bool init_SDL(SDL_Window** window, SDL_Renderer** renderer, TTF_Font** font){
         goto cleanup_sdl;
     }
 
-    *window = SDL_CreateWindow("Snake Evolution Game", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, GRID_SIZE, GRID_SIZE, SDL_WINDOW_SHOWN);
+    *window = SDL_CreateWindow("Snake Evolution Game", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, viewSize, viewSize, SDL_WINDOW_SHOWN);
     if (!*window){
         fprintf(stderr, "Could not create window: %s\n", SDL_GetError());
         goto cleanup_ttf;
@@ -527,15 +1167,17 @@ float randomFloatInRange(float range){
     return ((float)rand() / RAND_MAX) * (2 * range) - range;
 }
 
+// saving only copies the population, the checkpoint writer thread does the file I/O
 void manageNeuralNetworks(char action){
-    for (int s = 0; s < SNAKE_COUNT; s++){
-        char filename[20];
-        sprintf(filename, "weights_S%d.dat", s);
-
-        if (action == 's'){
-            saveLoadNetwork(&snakes[s].brain, filename, 's');
-        } else if (action == 'l'){
-            saveLoadNetwork(&snakes[s].brain, filename, 'l');
+    if (action == 's'){
+        submitCheckpoint(&checkpoints, populations[currentPopulation].networks, config.snakeCount, simTicks, evolutionEvents, (uint32_t)config.seed);
+    } else if (action == 'l'){
+        char path[CHECKPOINT_FILE_MAX];
+        CheckpointHeader header;
+        if(latestCheckpoint(config.checkpointPath, path, sizeof(path))){
+            fprintf(stderr, "No checkpoint named %s.*.ckpt to load\n", config.checkpointPath);
+        }else if(!loadCheckpoint(path, populations[currentPopulation].networks, config.snakeCount, &header)){
+            printf("Loaded %u networks from %s (generation %u)\n", MIN(header.count, (uint32_t)config.snakeCount), path, header.generation);
         }
     }
 }
@@ -1,4 +1,5 @@
 #include "neural_network.h"
+#include "alloc_stats.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
@@ -47,10 +48,10 @@ int max_element_index(float* array, int size) {
 
 void initializeNetwork(NeuralNetwork *nn, int num_input, int num_hidden_neurons, int num_output_neurons) {
     void initializeNeurons(Layer *layer, int num_weights) {
-        layer->neurons = (Neuron *)malloc(layer->num_neurons * sizeof(Neuron));
+        layer->neurons = (Neuron *)statMalloc(ALLOC_NETWORKS, layer->num_neurons * sizeof(Neuron));
         for (int i = 0; i < layer->num_neurons; i++) {
             Neuron *neuron = &layer->neurons[i];
-            neuron->weights = (float *)malloc(num_weights * sizeof(float));
+            neuron->weights = (float *)statMalloc(ALLOC_NETWORKS, num_weights * sizeof(float));
             neuron->bias = (float)rand() / RAND_MAX;
             for (int j = 0; j < num_weights; j++) neuron->weights[j] = (float)rand() / RAND_MAX;
         }
@@ -87,6 +88,46 @@ void forwardPropagation(NeuralNetwork *nn, float input[]) {
 }
 
 
+// Inference only: nothing in nn is written, so any number of threads can share
+// one network. The output sigmoid is monotonic and only applied when scores are
+// wanted; ties still go to the lowest index like max_element_index.
+static int inferForward(const NeuralNetwork *nn, const float input[], float hidden[], float scores[]) {
+    for (int i = 0; i < nn->hidden_layer.num_neurons; i++) {
+        const Neuron *neuron = &nn->hidden_layer.neurons[i];
+        float sum = 0;
+        for (int j = 0; j < nn->num_input; j++) {
+            sum += input[j] * neuron->weights[j];
+        }
+        hidden[i] = sigmoid(sum + neuron->bias);
+    }
+
+    int best = 0;
+    float bestSum = 0;
+    for (int i = 0; i < nn->output_layer.num_neurons; i++) {
+        const Neuron *neuron = &nn->output_layer.neurons[i];
+        float sum = 0;
+        for (int j = 0; j < nn->hidden_layer.num_neurons; j++) {
+            sum += hidden[j] * neuron->weights[j];
+        }
+        sum += neuron->bias;
+        if (scores) scores[i] = sigmoid(sum);
+        if (i == 0 || sum > bestSum) {
+            best = i;
+            bestSum = sum;
+        }
+    }
+    return best;
+}
+
+int inferAction(const NeuralNetwork *nn, const float input[], float hidden[]) {
+    return inferForward(nn, input, hidden, NULL);
+}
+
+int inferScores(const NeuralNetwork *nn, const float input[], float hidden[], float scores[]) {
+    return inferForward(nn, input, hidden, scores);
+}
+
+
 void backwardPropagation(NeuralNetwork *nn, float target[]) {
     for (int i = 0; i < nn->output_layer.num_neurons; i++) {
         Neuron *neuron = &nn->output_layer.neurons[i];
@@ -105,20 +146,163 @@ void backwardPropagation(NeuralNetwork *nn, float target[]) {
 }
 
 void updateWeights(NeuralNetwork *nn, float input[], float learningRate) {
-    for (int i = 0; i < nn->hidden_layer.num_neurons; i++) {
+    updateWeightsFrom(nn, nn, input, learningRate);
+}
+
+void updateWeightsFrom(NeuralNetwork *target, NeuralNetwork *source, float input[], float learningRate) {
+    for (int i = 0; i < source->hidden_layer.num_neurons; i++) {
+        Neuron *neuron = &target->hidden_layer.neurons[i];
+        float delta = source->hidden_layer.neurons[i].delta;
+        for (int j = 0; j < source->num_input; j++) {
+            neuron->weights[j] += learningRate * delta * input[j];
+        }
+        neuron->bias += learningRate * delta;
+    }
+
+    for (int i = 0; i < source->output_layer.num_neurons; i++) {
+        Neuron *neuron = &target->output_layer.neurons[i];
+        float delta = source->output_layer.neurons[i].delta;
+        for (int j = 0; j < source->hidden_layer.num_neurons; j++) {
+            neuron->weights[j] += learningRate * delta * source->hidden_layer.neurons[j].output;
+        }
+        neuron->bias += learningRate * delta;
+    }
+}
+
+// Output layer half of a fused step: computes output deltas, then in one sweep over the
+// output weights gathers the hidden errors (from the old weights) and applies the update.
+static void fusedOutputStep(NeuralNetwork *nn, float hidden[], float target[], float learningRate, float output[], float hiddenDelta[]) {
+    int num_hidden = nn->hidden_layer.num_neurons;
+    for (int i = 0; i < num_hidden; i++) hiddenDelta[i] = 0;
+
+    for (int i = 0; i < nn->output_layer.num_neurons; i++) {
+        Neuron *neuron = &nn->output_layer.neurons[i];
+        float sum = 0;
+        for (int j = 0; j < num_hidden; j++) sum += hidden[j] * neuron->weights[j];
+        output[i] = sigmoid(sum + neuron->bias);
+    }
+
+    for (int i = 0; i < nn->output_layer.num_neurons; i++) {
+        Neuron *neuron = &nn->output_layer.neurons[i];
+        float delta = (target[i] - output[i]) * dSigmoid(output[i]);
+        for (int j = 0; j < num_hidden; j++) {
+            hiddenDelta[j] += neuron->weights[j] * delta;
+            neuron->weights[j] += learningRate * delta * hidden[j];
+        }
+        neuron->bias += learningRate * delta;
+    }
+
+    for (int i = 0; i < num_hidden; i++) hiddenDelta[i] *= dSigmoid(hidden[i]);
+}
+
+// Same arithmetic as forwardPropagation + backwardPropagation + updateWeights, but activations
+// and deltas stay in stack buffers instead of the Neuron structs.
+int trainStep(NeuralNetwork *nn, float input[], float target[], float learningRate, float output[]) {
+    int num_hidden = nn->hidden_layer.num_neurons;
+    float hidden[num_hidden];
+    float hiddenDelta[num_hidden];
+
+    for (int i = 0; i < num_hidden; i++) {
+        Neuron *neuron = &nn->hidden_layer.neurons[i];
+        float sum = 0;
+        for (int j = 0; j < nn->num_input; j++) sum += input[j] * neuron->weights[j];
+        hidden[i] = sigmoid(sum + neuron->bias);
+    }
+
+    fusedOutputStep(nn, hidden, target, learningRate, output, hiddenDelta);
+
+    for (int i = 0; i < num_hidden; i++) {
         Neuron *neuron = &nn->hidden_layer.neurons[i];
+        for (int j = 0; j < nn->num_input; j++) neuron->weights[j] += learningRate * hiddenDelta[i] * input[j];
+        neuron->bias += learningRate * hiddenDelta[i];
+    }
+    return max_element_index(output, nn->output_layer.num_neurons);
+}
+
+// Sequential SGD over count samples, identical to calling trainStep on each. The hidden
+// weight update of a sample is deferred and folded into the next sample's forward sweep,
+// so the large input layer is swept once per sample instead of twice.
+void trainBatch(NeuralNetwork *nn, float inputs[], float targets[], int count, float learningRate, float outputs[]) {
+    int num_hidden = nn->hidden_layer.num_neurons;
+    int num_output = nn->output_layer.num_neurons;
+    float hidden[num_hidden];
+    float hiddenDelta[num_hidden];
+    float *pendingInput = NULL; // previous sample, whose hidden update is still owed
+
+    for (int s = 0; s < count; s++) {
+        float *input = &inputs[(size_t)s * nn->num_input];
+        for (int i = 0; i < num_hidden; i++) {
+            Neuron *neuron = &nn->hidden_layer.neurons[i];
+            float sum = 0;
+            if (pendingInput) {
+                float step = learningRate * hiddenDelta[i];
+                for (int j = 0; j < nn->num_input; j++) {
+                    neuron->weights[j] += step * pendingInput[j];
+                    sum += input[j] * neuron->weights[j];
+                }
+                neuron->bias += step;
+            } else {
+                for (int j = 0; j < nn->num_input; j++) sum += input[j] * neuron->weights[j];
+            }
+            hidden[i] = sigmoid(sum + neuron->bias);
+        }
+
+        fusedOutputStep(nn, hidden, &targets[s * num_output], learningRate, &outputs[s * num_output], hiddenDelta);
+        pendingInput = input;
+    }
+
+    for (int i = 0; pendingInput && i < num_hidden; i++) {
+        Neuron *neuron = &nn->hidden_layer.neurons[i];
+        for (int j = 0; j < nn->num_input; j++) neuron->weights[j] += learningRate * hiddenDelta[i] * pendingInput[j];
+        neuron->bias += learningRate * hiddenDelta[i];
+    }
+}
+
+void accumulateGradients(NeuralNetwork *nn, float input[], NeuralNetwork *gradients) {
+    for (int i = 0; i < nn->hidden_layer.num_neurons; i++) {
+        Neuron *grad = &gradients->hidden_layer.neurons[i];
+        float delta = nn->hidden_layer.neurons[i].delta;
         for (int j = 0; j < nn->num_input; j++) {
-            neuron->weights[j] += learningRate * neuron->delta * input[j];
+            grad->weights[j] += delta * input[j];
         }
-        neuron->bias += learningRate * neuron->delta;
+        grad->bias += delta;
     }
 
     for (int i = 0; i < nn->output_layer.num_neurons; i++) {
-        Neuron *neuron = &nn->output_layer.neurons[i];
+        Neuron *grad = &gradients->output_layer.neurons[i];
+        float delta = nn->output_layer.neurons[i].delta;
         for (int j = 0; j < nn->hidden_layer.num_neurons; j++) {
-            neuron->weights[j] += learningRate * neuron->delta * nn->hidden_layer.neurons[j].output;
+            grad->weights[j] += delta * nn->hidden_layer.neurons[j].output;
+        }
+        grad->bias += delta;
+    }
+}
+
+void applyGradients(NeuralNetwork *nn, NeuralNetwork *gradients, float scale) {
+    Layer *layers[] = {&nn->hidden_layer, &nn->output_layer};
+    Layer *gradLayers[] = {&gradients->hidden_layer, &gradients->output_layer};
+    int num_weights[] = {nn->num_input, nn->hidden_layer.num_neurons};
+
+    for (int l = 0; l < 2; l++) {
+        for (int i = 0; i < layers[l]->num_neurons; i++) {
+            Neuron *neuron = &layers[l]->neurons[i];
+            Neuron *grad = &gradLayers[l]->neurons[i];
+            for (int j = 0; j < num_weights[l]; j++) neuron->weights[j] += scale * grad->weights[j];
+            neuron->bias += scale * grad->bias;
+        }
+    }
+}
+
+void zeroNetwork(NeuralNetwork *nn) {
+    Layer *layers[] = {&nn->hidden_layer, &nn->output_layer};
+    int num_weights[] = {nn->num_input, nn->hidden_layer.num_neurons};
+
+    for (int l = 0; l < 2; l++) {
+        for (int i = 0; i < layers[l]->num_neurons; i++) {
+            Neuron *neuron = &layers[l]->neurons[i];
+            for (int j = 0; j < num_weights[l]; j++) neuron->weights[j] = 0;
+            neuron->bias = 0;
         }
-        neuron->bias += learningRate * neuron->delta;
     }
 }
 
@@ -144,28 +328,37 @@ void testNetwork(NeuralNetwork *nn, float inputs[][2], float targets[]) {
 
 
 
-void mutateNeuralNetwork(NeuralNetwork *nn, float rate, float magnitude) {    
+// uniform in [0, 1], from rand() or from a caller-owned rand_r() seed
+static inline float mutationRandom(unsigned int *seed) {
+    return (float)(seed ? rand_r(seed) : rand()) / RAND_MAX;
+}
+
+void mutateNeuralNetworkSeeded(NeuralNetwork *nn, float rate, float magnitude, unsigned int *seed) {
     for (int i = 0; i < nn->hidden_layer.num_neurons; i++) {
         Neuron *neuron = &nn->hidden_layer.neurons[i];
-        if ((float)rand() / RAND_MAX < rate) {
-            neuron->bias += ((float)rand() / RAND_MAX * 2 - 1) * magnitude;
+        if (mutationRandom(seed) < rate) {
+            neuron->bias += (mutationRandom(seed) * 2 - 1) * magnitude;
             for (int j = 0; j < nn->num_input; j++) {
-                neuron->weights[j] += ((float)rand() / RAND_MAX * 2 - 1) * magnitude;
+                neuron->weights[j] += (mutationRandom(seed) * 2 - 1) * magnitude;
             }
         }
     }
     
     for (int i = 0; i < nn->output_layer.num_neurons; i++) {
         Neuron *neuron = &nn->output_layer.neurons[i];
-        if ((float)rand() / RAND_MAX < rate) {
-            neuron->bias += ((float)rand() / RAND_MAX * 2 - 1) * magnitude;
+        if (mutationRandom(seed) < rate) {
+            neuron->bias += (mutationRandom(seed) * 2 - 1) * magnitude;
             for (int j = 0; j < nn->hidden_layer.num_neurons; j++) {
-                neuron->weights[j] += ((float)rand() / RAND_MAX * 2 - 1) * magnitude;
+                neuron->weights[j] += (mutationRandom(seed) * 2 - 1) * magnitude;
             }
         }
     }
 }
 
+void mutateNeuralNetwork(NeuralNetwork *nn, float rate, float magnitude) {
+    mutateNeuralNetworkSeeded(nn, rate, magnitude, NULL);
+}
+
 
 
 void copyNeuralNetwork(NeuralNetwork *sourceNN, NeuralNetwork *targetNN) {
@@ -195,23 +388,105 @@ void copyNeuralNetwork(NeuralNetwork *sourceNN, NeuralNetwork *targetNN) {
     }
 }
 
+void shareNeuralNetwork(NeuralNetwork *sourceNN, NeuralNetwork *targetNN) {
+    for (int i = 0; i < sourceNN->hidden_layer.num_neurons; i++) {
+        targetNN->hidden_layer.neurons[i].weights = sourceNN->hidden_layer.neurons[i].weights;
+        targetNN->hidden_layer.neurons[i].bias = sourceNN->hidden_layer.neurons[i].bias;
+    }
+    for (int i = 0; i < sourceNN->output_layer.num_neurons; i++) {
+        targetNN->output_layer.neurons[i].weights = sourceNN->output_layer.neurons[i].weights;
+        targetNN->output_layer.neurons[i].bias = sourceNN->output_layer.neurons[i].bias;
+    }
+}
+
 void cleanupNeuralNetwork(NeuralNetwork *nn) {
     // Cleanup hidden layer
     for (int i = 0; i < nn->hidden_layer.num_neurons; i++) {
         Neuron *neuron = &nn->hidden_layer.neurons[i];
-        free(neuron->weights); // Free weights array for each neuron
+        statFree(ALLOC_NETWORKS, neuron->weights, nn->num_input * sizeof(float)); // Free weights array for each neuron
     }
-    free(nn->hidden_layer.neurons); // Free neurons array for the hidden layer
+    statFree(ALLOC_NETWORKS, nn->hidden_layer.neurons, nn->hidden_layer.num_neurons * sizeof(Neuron)); // Free neurons array for the hidden layer
 
     // Cleanup output layer
     for (int i = 0; i < nn->output_layer.num_neurons; i++) {
         Neuron *neuron = &nn->output_layer.neurons[i];
-        free(neuron->weights); // Free weights array for each neuron
+        statFree(ALLOC_NETWORKS, neuron->weights, nn->hidden_layer.num_neurons * sizeof(float)); // Free weights array for each neuron
     }
-    free(nn->output_layer.neurons); // Free neurons array for the output layer
+    statFree(ALLOC_NETWORKS, nn->output_layer.neurons, nn->output_layer.num_neurons * sizeof(Neuron)); // Free neurons array for the output layer
+}
+
+bool initNetworkArena(NetworkArena *arena, int count, int num_input, int num_hidden_neurons, int num_output_neurons) {
+    int neuronsPerNetwork = num_hidden_neurons + num_output_neurons;
+    size_t weightsPerNetwork = (size_t)num_hidden_neurons * num_input + (size_t)num_output_neurons * num_hidden_neurons;
+    size_t networkBytes = count * sizeof(NeuralNetwork);
+    size_t neuronBytes = (size_t)count * neuronsPerNetwork * sizeof(Neuron);
+
+    // [networks][neurons][weights], each block stays aligned since the structs are pointer-sized multiples
+    arena->count = count;
+    arena->bytes = networkBytes + neuronBytes + (size_t)count * weightsPerNetwork * sizeof(float);
+    arena->memory = statMalloc(ALLOC_NETWORKS, arena->bytes);
+    if (!arena->memory) {
+        arena->networks = NULL;
+        return true;
+    }
+    arena->networks = (NeuralNetwork *)arena->memory;
+    Neuron *neurons = (Neuron *)((char *)arena->memory + networkBytes);
+    float *weights = (float *)((char *)arena->memory + networkBytes + neuronBytes);
+
+    for (int n = 0; n < count; n++) {
+        NeuralNetwork *nn = &arena->networks[n];
+        nn->num_input = num_input;
+        nn->hidden_layer.num_neurons = num_hidden_neurons;
+        nn->output_layer.num_neurons = num_output_neurons;
+        nn->hidden_layer.neurons = neurons;
+        nn->output_layer.neurons = neurons + num_hidden_neurons;
+        neurons += neuronsPerNetwork;
+
+        Layer *layers[] = {&nn->hidden_layer, &nn->output_layer};
+        int num_weights[] = {num_input, num_hidden_neurons};
+        for (int l = 0; l < 2; l++) {
+            for (int i = 0; i < layers[l]->num_neurons; i++) {
+                Neuron *neuron = &layers[l]->neurons[i];
+                neuron->weights = weights;
+                weights += num_weights[l];
+                neuron->bias = (float)rand() / RAND_MAX;
+                for (int j = 0; j < num_weights[l]; j++) neuron->weights[j] = (float)rand() / RAND_MAX;
+            }
+        }
+    }
+    return false;
+}
+
+bool initNetworkViews(NetworkArena *arena, int count, NeuralNetwork *shared) {
+    int neuronsPerNetwork = shared->hidden_layer.num_neurons + shared->output_layer.num_neurons;
+    size_t networkBytes = count * sizeof(NeuralNetwork);
+
+    // [networks][neurons], the weights stay in shared
+    arena->count = count;
+    arena->bytes = networkBytes + (size_t)count * neuronsPerNetwork * sizeof(Neuron);
+    arena->memory = statMalloc(ALLOC_NETWORKS, arena->bytes);
+    if (!arena->memory) {
+        arena->networks = NULL;
+        return true;
+    }
+    arena->networks = (NeuralNetwork *)arena->memory;
+    Neuron *neurons = (Neuron *)((char *)arena->memory + networkBytes);
+    for (int n = 0; n < count; n++) {
+        NeuralNetwork *view = &arena->networks[n];
+        *view = *shared;
+        view->hidden_layer.neurons = neurons;
+        view->output_layer.neurons = neurons + shared->hidden_layer.num_neurons;
+        neurons += neuronsPerNetwork;
+        shareNeuralNetwork(shared, view);
+    }
+    return false;
+}
 
-    // Finally, free the neural network structure itself
-    free(nn);
+void cleanupNetworkArena(NetworkArena *arena) {
+    statFree(ALLOC_NETWORKS, arena->memory, arena->bytes);
+    arena->memory = NULL;
+    arena->networks = NULL;
+    arena->count = 0;
 }
 
 
@@ -24,19 +24,40 @@ typedef struct NeuralNetwork {
     Layer output_layer;
 } NeuralNetwork;
 
+// a whole population of identically shaped networks carved out of one allocation
+typedef struct NetworkArena {
+    int count;
+    NeuralNetwork *networks;
+    void *memory;
+    size_t bytes;
+} NetworkArena;
+
 
 float sigmoid(float x);
 float dSigmoid(float x);
 int max_element_index(float* array, int size);
 void initializeNetwork(NeuralNetwork *nn, int num_input, int num_hidden_neurons, int num_output_neurons);
 void forwardPropagation(NeuralNetwork *nn, float input[]);
+int inferAction(const NeuralNetwork *nn, const float input[], float hidden[]); // argmax output, hidden is scratch for hidden_layer.num_neurons floats
+int inferScores(const NeuralNetwork *nn, const float input[], float hidden[], float scores[]); // inferAction plus the sigmoid output scores
 void backwardPropagation(NeuralNetwork *nn, float target[]);
 void updateWeights(NeuralNetwork *nn, float input[], float learningRate);
+void updateWeightsFrom(NeuralNetwork *target, NeuralNetwork *source, float input[], float learningRate); // deltas/outputs of source applied to target
+void accumulateGradients(NeuralNetwork *nn, float input[], NeuralNetwork *gradients); // gradients has nn's shape, same sign as updateWeights
+void applyGradients(NeuralNetwork *nn, NeuralNetwork *gradients, float scale);
+void zeroNetwork(NeuralNetwork *nn);
+int trainStep(NeuralNetwork *nn, float input[], float target[], float learningRate, float output[]); // fused forward/backward/update, returns argmax
+void trainBatch(NeuralNetwork *nn, float inputs[], float targets[], int count, float learningRate, float outputs[]); // trainStep over count samples
 void trainNetwork(NeuralNetwork *nn, float inputs[][2], float targets[], int epochs, float learningRate);
 void testNetwork(NeuralNetwork *nn, float inputs[][2], float targets[]);
 void mutateNeuralNetwork(NeuralNetwork *nn, float rate, float magnitude);
+void mutateNeuralNetworkSeeded(NeuralNetwork *nn, float rate, float magnitude, unsigned int *seed); // thread-safe, reproducible; NULL seed uses rand()
 void copyNeuralNetwork(NeuralNetwork *sourceNN, NeuralNetwork *targetNN);
+void shareNeuralNetwork(NeuralNetwork *sourceNN, NeuralNetwork *targetNN); // points target's weights at source's and copies the biases, which are stored by value
 void cleanupNeuralNetwork(NeuralNetwork *nn);
+bool initNetworkArena(NetworkArena *arena, int count, int num_input, int num_hidden_neurons, int num_output_neurons); // true on error
+bool initNetworkViews(NetworkArena *arena, int count, NeuralNetwork *shared); // networks with own neurons but no weights, see shareNeuralNetwork; true on error
+void cleanupNetworkArena(NetworkArena *arena);
 
 //save and load to and from CSV
 void processNeuron(Neuron *neuron, FILE *file, int num_weights, char mode); // helper func
@@ -0,0 +1,272 @@
+#include "replay.h"
+#include "alloc_stats.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char *actionNames[] = { "nothing", "up", "down", "left", "right" };
+
+
+uint64_t hashNetworks(NeuralNetwork *networks, int count) {
+    uint64_t hash = 14695981039346656037ull; // FNV-1a over the raw float bits
+    for (int n = 0; n < count; n++) {
+        Layer *layers[] = {&networks[n].hidden_layer, &networks[n].output_layer};
+        int num_weights[] = {networks[n].num_input, networks[n].hidden_layer.num_neurons};
+        for (int l = 0; l < 2; l++) {
+            for (int i = 0; i < layers[l]->num_neurons; i++) {
+                Neuron *neuron = &layers[l]->neurons[i];
+                for (int j = 0; j <= num_weights[l]; j++) {
+                    uint32_t bits;
+                    memcpy(&bits, j < num_weights[l] ? &neuron->weights[j] : &neuron->bias, sizeof(bits));
+                    for (int b = 0; b < 4; b++) hash = (hash ^ ((bits >> (8 * b)) & 0xFF)) * 1099511628211ull;
+                }
+            }
+        }
+    }
+    return hash;
+}
+
+static bool reserveBlock(Replay *replay, size_t size) {
+    if (size <= replay->blockCapacity) return true;
+    size_t capacity = replay->blockCapacity ? replay->blockCapacity : 256;
+    while (capacity < size) capacity *= 2;
+    unsigned char *grown = (unsigned char *)statRealloc(ALLOC_RECORDING, replay->block, replay->blockCapacity, capacity);
+    if (!grown) return false;
+    replay->block = grown;
+    replay->blockCapacity = capacity;
+    return true;
+}
+
+static void describeFrame(const unsigned char *frame, size_t available, char *out, size_t size) {
+    if (available == 0) { snprintf(out, size, "end of tick"); return; }
+    int32_t v[3];
+    switch (frame[0]) {
+        case FRAME_COMMAND: snprintf(out, size, "command %d", frame[1]); break;
+        case FRAME_GENERATION: {
+            uint32_t generation;
+            memcpy(&generation, frame + 1, sizeof(generation));
+            snprintf(out, size, "generation %u", generation);
+            break;
+        }
+        case FRAME_EAT:
+            memcpy(v, frame + 1, sizeof(v));
+            snprintf(out, size, "snake %d eats at (%d, %d)", v[0], v[1], v[2]);
+            break;
+        case FRAME_SPAWN:
+            memcpy(v, frame + 1, 2 * sizeof(int32_t));
+            snprintf(out, size, "food spawns at (%d, %d)", v[0], v[1]);
+            break;
+        default: snprintf(out, size, "frame type %d", frame[0]); break;
+    }
+}
+
+static void diverge(Replay *replay, const char *what, const unsigned char *frame, size_t size) {
+    char expected[96], actual[96];
+    describeFrame(replay->block + replay->cursor, replay->actionsStart - replay->cursor, expected, sizeof(expected));
+    describeFrame(frame, size, actual, sizeof(actual));
+    snprintf(replay->divergence, sizeof(replay->divergence), "tick %lu, %s: recorded %s, replay produced %s", replay->tick, what, expected, actual);
+    replay->diverged = true;
+}
+
+// record: append the frame to this tick's block; verify: it must match the next recorded frame
+static void replayFrame(Replay *replay, const char *what, const unsigned char *frame, size_t size) {
+    if (replay->mode == REPLAY_RECORD) {
+        if (!reserveBlock(replay, replay->blockSize + size)) {
+            perror("Memory allocation error");
+            exit(1);
+        }
+        memcpy(replay->block + replay->blockSize, frame, size);
+        replay->blockSize += size;
+    } else if (replay->mode == REPLAY_VERIFY && !replay->diverged) {
+        if (replay->cursor + size > replay->actionsStart || memcmp(replay->block + replay->cursor, frame, size) != 0) {
+            diverge(replay, what, frame, size);
+            return;
+        }
+        replay->cursor += size;
+    }
+}
+
+// the generation frame carries every snake's fitness, so its size is fixed by the header
+static bool allocGenerationFrame(Replay *replay) {
+    replay->generationFrameSize = 1 + sizeof(uint32_t) + replay->header.snakeCount * sizeof(float);
+    replay->generationFrame = (unsigned char *)statMalloc(ALLOC_RECORDING, replay->generationFrameSize);
+    return replay->generationFrame == NULL;
+}
+
+bool startRecording(Replay *replay, const char *path, const ReplayHeader *header) {
+    memset(replay, 0, sizeof(*replay));
+    replay->file = fopen(path, "wb");
+    if (!replay->file) {
+        fprintf(stderr, "Could not create replay log %s\n", path);
+        return true;
+    }
+    replay->header = *header;
+    memcpy(replay->header.magic, REPLAY_MAGIC, 4);
+    replay->header.version = REPLAY_VERSION;
+    replay->actionBytes = (header->snakeCount + 1) / 2;
+    replay->actions = (unsigned char *)statCalloc(ALLOC_RECORDING, replay->actionBytes, 1);
+    if (!replay->actions || allocGenerationFrame(replay) || fwrite(&replay->header, sizeof(replay->header), 1, replay->file) != 1) {
+        fclose(replay->file);
+        statFree(ALLOC_RECORDING, replay->actions, replay->actionBytes);
+        statFree(ALLOC_RECORDING, replay->generationFrame, replay->generationFrameSize);
+        return true;
+    }
+    replay->mode = REPLAY_RECORD;
+    return false;
+}
+
+bool openReplay(Replay *replay, const char *path, float tolerance) {
+    memset(replay, 0, sizeof(*replay));
+    replay->file = fopen(path, "rb");
+    if (!replay->file) {
+        fprintf(stderr, "Could not open replay log %s\n", path);
+        return true;
+    }
+    if (fread(&replay->header, sizeof(replay->header), 1, replay->file) != 1 || memcmp(replay->header.magic, REPLAY_MAGIC, 4) != 0 ||
+        replay->header.version != REPLAY_VERSION || replay->header.snakeCount < 1) {
+        fprintf(stderr, "%s is not a replay log\n", path);
+        fclose(replay->file);
+        return true;
+    }
+    if (allocGenerationFrame(replay)) {
+        fclose(replay->file);
+        return true;
+    }
+    replay->actionBytes = (replay->header.snakeCount + 1) / 2;
+    replay->tolerance = tolerance;
+    replay->mode = REPLAY_VERIFY;
+    return false;
+}
+
+bool checkReplayWeights(Replay *replay, uint64_t weightsHash) {
+    if (replay->mode == REPLAY_RECORD) {
+        // the population exists only after the header went out, patch it in place
+        replay->header.weightsHash = weightsHash;
+        long end = ftell(replay->file);
+        fseek(replay->file, 0, SEEK_SET);
+        fwrite(&replay->header, sizeof(replay->header), 1, replay->file);
+        fseek(replay->file, end, SEEK_SET);
+    } else if (replay->mode == REPLAY_VERIFY && replay->header.weightsHash != weightsHash) {
+        snprintf(replay->divergence, sizeof(replay->divergence),
+                 "initial population differs from the recording (different weights.csv or network code)");
+        replay->diverged = true;
+        return false;
+    }
+    return true;
+}
+
+bool beginReplayTick(Replay *replay) {
+    if (replay->mode == REPLAY_RECORD) {
+        replay->blockSize = 0;
+        memset(replay->actions, 0, replay->actionBytes);
+        return true;
+    }
+    if (replay->mode != REPLAY_VERIFY) return true;
+    if (replay->diverged) return false;
+
+    uint32_t size;
+    if (fread(&size, sizeof(size), 1, replay->file) != 1) return false; // end of the recording
+    if (size < (uint32_t)replay->actionBytes + 1 || !reserveBlock(replay, size) || fread(replay->block, 1, size, replay->file) != size ||
+        replay->block[size - replay->actionBytes - 1] != FRAME_ACTIONS) {
+        snprintf(replay->divergence, sizeof(replay->divergence), "tick %lu: replay log is truncated or corrupt", replay->tick);
+        replay->diverged = true;
+        return false;
+    }
+    replay->blockSize = size;
+    replay->cursor = 0;
+    replay->actionsStart = size - replay->actionBytes - 1;
+    return true;
+}
+
+void endReplayTick(Replay *replay) {
+    if (replay->mode == REPLAY_RECORD) {
+        unsigned char type = FRAME_ACTIONS;
+        replayFrame(replay, "actions", &type, 1);
+        replayFrame(replay, "actions", replay->actions, replay->actionBytes);
+        uint32_t size = (uint32_t)replay->blockSize;
+        fwrite(&size, sizeof(size), 1, replay->file);
+        fwrite(replay->block, 1, replay->blockSize, replay->file);
+    } else if (replay->mode == REPLAY_VERIFY && !replay->diverged && replay->cursor != replay->actionsStart) {
+        diverge(replay, "end of tick", NULL, 0);
+    }
+    replay->tick++;
+}
+
+void recordReplayCommand(Replay *replay, int command) {
+    if (replay->mode != REPLAY_RECORD) return;
+    unsigned char frame[2] = { FRAME_COMMAND, (unsigned char)command };
+    replayFrame(replay, "command", frame, sizeof(frame));
+}
+
+bool nextReplayCommand(Replay *replay, int *command) {
+    if (replay->mode != REPLAY_VERIFY || replay->diverged || replay->cursor >= replay->actionsStart ||
+        replay->block[replay->cursor] != FRAME_COMMAND) return false;
+    *command = replay->block[replay->cursor + 1];
+    replay->cursor += 2;
+    return true;
+}
+
+int replayAction(Replay *replay, int snake, int action) {
+    if (replay->mode == REPLAY_RECORD) {
+        replay->actions[snake / 2] |= (unsigned char)(action << (4 * (snake & 1)));
+        return action;
+    }
+    if (replay->mode != REPLAY_VERIFY || replay->diverged) return action;
+
+    const unsigned char *actions = replay->block + replay->actionsStart + 1;
+    int recorded = (actions[snake / 2] >> (4 * (snake & 1))) & 0xF;
+    replay->actionsCompared++;
+    if (recorded != action) {
+        if (replay->actionMismatches++ == 0) {
+            snprintf(replay->firstMismatch, sizeof(replay->firstMismatch), "tick %lu, snake %d: recorded %s, replay chose %s",
+                     replay->tick, snake, actionNames[recorded % 5], actionNames[action % 5]);
+        }
+    }
+    return recorded;
+}
+
+void replayFood(Replay *replay, ReplayFrame kind, int snake, int x, int y) {
+    if (replay->mode == REPLAY_OFF) return;
+    unsigned char frame[1 + 3 * sizeof(int32_t)];
+    int32_t values[3] = { snake, x, y };
+    int fields = kind == FRAME_EAT ? 3 : 2; // spawns have no snake
+    frame[0] = (unsigned char)kind;
+    memcpy(frame + 1, values + 3 - fields, fields * sizeof(int32_t));
+    replayFrame(replay, kind == FRAME_EAT ? "food eaten" : "food spawned", frame, 1 + fields * sizeof(int32_t));
+}
+
+void replayGeneration(Replay *replay, uint32_t generation, const float fitness[]) {
+    if (replay->mode == REPLAY_OFF) return;
+    unsigned char *frame = replay->generationFrame;
+    frame[0] = FRAME_GENERATION;
+    memcpy(frame + 1, &generation, sizeof(generation));
+    memcpy(frame + 1 + sizeof(generation), fitness, replay->header.snakeCount * sizeof(float));
+    replayFrame(replay, "generation fitness", frame, replay->generationFrameSize);
+}
+
+bool finishReplay(Replay *replay) {
+    if (replay->mode == REPLAY_OFF) return false;
+    bool failed = false;
+    if (replay->mode == REPLAY_RECORD) {
+        printf("Recorded %lu ticks (seed %u)\n", replay->tick, replay->header.seed);
+    } else {
+        double rate = replay->actionsCompared ? (double)replay->actionMismatches / replay->actionsCompared : 0;
+        if (replay->diverged) {
+            printf("Replay diverged: %s\n", replay->divergence);
+            failed = true;
+        } else {
+            printf("Replayed %lu ticks: food events and fitness matched\n", replay->tick);
+        }
+        if (replay->actionMismatches) {
+            if (rate > replay->tolerance) failed = true;
+            printf("%lu of %lu actions differed (%.4f%%, tolerance %.4f%%%s), first at %s\n", replay->actionMismatches,
+                   replay->actionsCompared, rate * 100, replay->tolerance * 100, rate > replay->tolerance ? ", exceeded" : "",
+                   replay->firstMismatch);
+        }
+    }
+    fclose(replay->file);
+    statFree(ALLOC_RECORDING, replay->block, replay->blockCapacity);
+    statFree(ALLOC_RECORDING, replay->actions, replay->actionBytes);
+    statFree(ALLOC_RECORDING, replay->generationFrame, replay->generationFrameSize);
+    memset(replay, 0, sizeof(*replay));
+    return failed;
+}
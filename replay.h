@@ -0,0 +1,95 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "neural_network.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define REPLAY_MAGIC "SNRP"
+#define REPLAY_VERSION 5
+
+typedef enum {
+    REPLAY_OFF,
+    REPLAY_RECORD,
+    REPLAY_VERIFY,
+} ReplayMode;
+
+// frames inside a tick block, in the order the simulation produces them
+typedef enum {
+    FRAME_COMMAND = 1,    // u8 command
+    FRAME_GENERATION = 2, // u32 generation, snakeCount float fitness
+    FRAME_EAT = 3,        // i32 snake, i32 x, i32 y of the cell the snake moved onto
+    FRAME_SPAWN = 4,      // i32 x, i32 y
+    FRAME_ACTIONS = 5,    // one 4 bit action per snake, always the last frame of a block
+} ReplayFrame;
+
+// Everything a run depends on besides weights.csv, whose effect is checked through weightsHash.
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t seed;
+    int32_t gridSize;
+    int32_t snakeCount;
+    int32_t foodCount;
+    int32_t searchSize;
+    int32_t generationTicks;
+    int32_t numHidden;
+    float mutationRate;
+    float mutationMagnitude;
+    int32_t fovea;
+    int32_t visionRings;
+    int32_t maxLength;
+    int32_t cullIdle;
+    int32_t cullStagnant;
+    int32_t cullMargin;
+    int32_t cullGrace;
+    int32_t cullRespawn;
+    int32_t arenaSize;
+    int32_t arenaTicks;
+    int32_t arenaFood;
+    uint64_t weightsHash; // initial population
+} ReplayHeader;
+
+// A log is the header followed by one block per tick: a u32 payload size and
+// the tick's frames. Recording appends blocks; verifying re-runs the simulation,
+// feeds it the recorded commands and compares everything else frame by frame.
+// Recorded actions are replayed even when the new run picks another one, so the
+// world stays in step and action mismatches can be measured against a tolerance;
+// any other difference is a divergence and stops the replay.
+typedef struct {
+    ReplayMode mode;
+    FILE *file;
+    ReplayHeader header;
+    unsigned long tick;
+    unsigned char *block;
+    size_t blockSize, blockCapacity, cursor;
+    size_t actionsStart; // verify: offset of the FRAME_ACTIONS frame
+    int actionBytes;
+    unsigned char *actions; // record: this tick's packed actions
+    unsigned char *generationFrame; // reused by every replayGeneration
+    size_t generationFrameSize;
+
+    float tolerance; // allowed fraction of mismatched actions
+    unsigned long actionsCompared, actionMismatches;
+    char firstMismatch[128];
+    bool diverged;
+    char divergence[256];
+} Replay;
+
+bool startRecording(Replay *replay, const char *path, const ReplayHeader *header); // true on error
+bool openReplay(Replay *replay, const char *path, float tolerance); // true on error, header is read into replay->header
+bool checkReplayWeights(Replay *replay, uint64_t weightsHash); // record: stores the hash, verify: false if it differs
+uint64_t hashNetworks(NeuralNetwork *networks, int count);
+
+bool beginReplayTick(Replay *replay); // false once a verified replay has ended or diverged
+void endReplayTick(Replay *replay);
+void recordReplayCommand(Replay *replay, int command);
+bool nextReplayCommand(Replay *replay, int *command); // verify: next command of this tick
+int replayAction(Replay *replay, int snake, int action); // returns the action to take
+void replayFood(Replay *replay, ReplayFrame kind, int snake, int x, int y);
+void replayGeneration(Replay *replay, uint32_t generation, const float fitness[]);
+bool finishReplay(Replay *replay); // prints the outcome, true if the replay failed
+
+#endif // REPLAY_H
@@ -1,9 +1,15 @@
 #include "neural_network.h"
+#include "thread_pool.h"
+#include "telemetry.h"
+#include "checkpoint.h"
+#include "vision.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
 #include <time.h>
 #include <math.h>
+#include <limits.h>
 
 #define GRID_SIZE 51
 #define FOOD_VALUE 1.0f
@@ -11,7 +17,17 @@
 #define EMPTY_VALUE 0.0f
 #define NUM_SIMULATION_EVENTS 500000
 #define NUM_HIDDEN_LAYER_NEURONS 4
-#define DEBUGGING 1
+#define REPORT_INTERVAL 100
+#define BATCH_PER_THREAD 16
+#define FUSED_CHUNK 32
+#define VERIFY_TOLERANCE 1e-4f
+#define TELEMETRY_FILE "training.tlm"
+#define CHECKPOINT_BASE "sim_checkpoint"
+#define VISION_SCRATCH (2 * (GRID_SIZE + 1) * (GRID_SIZE + 1))
+#define SWEEP_MAX_VALUES 16
+#define SWEEP_SAMPLES 10000   // shared dataset, the last fifth is held out for the final score
+#define SWEEP_EVOLVE_BATCH 256 // samples a mutated child is judged on against its parent
+#define SWEEP_GENERATE_CHUNK 256
 
 typedef enum {
     DO_NOTHING,
@@ -21,23 +37,100 @@ typedef enum {
     GO_RIGHT,
 } Action;
 
-float grid[GRID_SIZE][GRID_SIZE];
-
-void initializeGrid() {
+typedef float Grid[GRID_SIZE][GRID_SIZE];
+
+typedef struct {
+    int threads;
+    int batch;        // samples per synchronous gradient step, 0 picks BATCH_PER_THREAD per worker
+    bool hogwild;     // lock-free asynchronous updates instead of reduced batches
+    int events;
+    float learningRate;
+    unsigned int seed;
+    int scaling;      // >0: measure samples/sec for 1..threads workers on this many samples
+    int verifyFused;  // >0: compare the fused kernels against the three-call sequence on this many samples
+    int reportInterval; // samples per loss/accuracy telemetry record
+    const char *telemetry;
+    int checkpointEvery; // samples between background checkpoints, 0 disables
+    int checkpointKeep;
+    const char *checkpoint;
+    bool resume;         // start from the newest checkpoint instead of weights.csv
+    int fovea;           // full-resolution centre of the foveated encoder, 0 feeds the raw grid
+    int visionRings;
+    // comma separated sweep grids; any of them switches to sweep mode
+    const char *sweepLearningRates;
+    const char *sweepHidden;
+    const char *sweepMutationRates;
+    const char *sweepMutationMagnitudes;
+    int sweepSamples;
+} TrainOptions;
+
+// per worker state, each thread trains on a private replica of the shared network
+typedef struct {
+    NeuralNetwork *replica;   // Hogwild: a view from initNetworkViews whose weights are the shared network's
+    NeuralNetwork *gradients; // synchronous mode only
+    Grid grid;
+    float input[GRID_SIZE * GRID_SIZE];
+    float scratch[VISION_SCRATCH];
+    int correctCount;
+    float totalLoss;
+} TrainWorker;
+
+typedef struct {
+    NeuralNetwork *nn;
+    TrainWorker *workers;
+    int workerCount;
+    const TrainOptions *options;
+    int first; // first event of the current round
+    int count;
+} TrainJob;
+
+// One point of the sweep grid. Candidates with a learning rate train with the
+// fused SGD kernel; candidates with a mutation rate evolve by (1+1) hill climbing.
+typedef struct {
+    int hidden;
+    float learningRate;
+    float mutationRate;
+    float mutationMagnitude;
+    NeuralNetwork nn;
+    NeuralNetwork child; // evolution only
+    float accuracy;      // on the held-out part of the dataset
+    float loss;
+    double seconds;
+} SweepCandidate;
+
+// samples generated once and read by every candidate
+typedef struct {
+    float *inputs; // count rows of inputCount floats
+    unsigned char *actions;
+    int count;
+    int trainCount; // rows before this are for training, the rest for scoring
+    int inputCount;
+    unsigned int seed;
+    SweepCandidate *candidates;
+    int events;
+} SweepJob;
+
+Grid grid;
+float visionScratch[VISION_SCRATCH];
+VisionEncoder visionEncoder;
+TelemetryLog telemetry;
+CheckpointWriter checkpoints;
+
+void initializeGrid(Grid grid) {
     for (int i = 0; i < GRID_SIZE; i++)
         for (int j = 0; j < GRID_SIZE; j++)
             grid[i][j] = EMPTY_VALUE;
 }
 
 
-void spawnFood(){
-    int foodX = rand() % GRID_SIZE;
-    int foodY = rand() % GRID_SIZE;
+void spawnFood(Grid grid, unsigned int *seed){
+    int foodX = rand_r(seed) % GRID_SIZE;
+    int foodY = rand_r(seed) % GRID_SIZE;
     grid[foodX][foodY] = FOOD_VALUE;
 }
 
-void spawnWalls(){
-    int wallSide = rand() % 4; // Choose a random side to spawn walls
+void spawnWalls(Grid grid, unsigned int *seed){
+    int wallSide = rand_r(seed) % 4; // Choose a random side to spawn walls
     for (int i = 0; i < GRID_SIZE; i++) {
         switch (wallSide) {
             case 0: grid[0][i] = WALL_VALUE; break; // Top
@@ -58,7 +151,7 @@ float calculateDistance(int x1, int y1, int x2, int y2){
     return sqrtf(x_diff * x_diff + y_diff * y_diff);
 }
 
-Action calculateCorrectAction() {
+Action calculateCorrectAction(Grid grid) {
     int agentX = GRID_SIZE / 2;
     int agentY = GRID_SIZE / 2;
     float closestFoodDistance = GRID_SIZE * 2.0;
@@ -87,121 +180,644 @@ Action calculateCorrectAction() {
     return correctAction;
 }
 
+// every event draws from its own seed, so a sample does not depend on which thread builds it
+unsigned int sampleSeed(unsigned int seed, int event) {
+    return seed ^ ((unsigned int)event * 2654435761u);
+}
 
+void generateSample(Grid grid, float input[], unsigned int seed, float scratch[]) {
+    initializeGrid(grid);
+
+    for(int i = 0; i < (rand_r(&seed) % 20); i++)
+        spawnFood(grid, &seed);
+
+    // 10% chance to spawn food next to the agent
+    if (rand_r(&seed) % 10 == 0) {
+        int agentX = GRID_SIZE / 2;
+        int agentY = GRID_SIZE / 2;
+        int direction = rand_r(&seed) % 4; // Choose a random direction: up, down, left, or right
+
+        switch (direction) {
+            case 0: // Up
+                if (agentX > 0) grid[agentX - 1][agentY] = FOOD_VALUE;
+                break;
+            case 1: // Down
+                if (agentX < GRID_SIZE - 1) grid[agentX + 1][agentY] = FOOD_VALUE;
+                break;
+            case 2: // Left
+                if (agentY > 0) grid[agentX][agentY - 1] = FOOD_VALUE;
+                break;
+            case 3: // Right
+                if (agentY < GRID_SIZE - 1) grid[agentX][agentY + 1] = FOOD_VALUE;
+                break;
+        }
+    }
+
+    encodeVision(&visionEncoder, &grid[0][0], input, scratch);
+}
 
 
-void printGrid();
+
+
+void printGrid(Grid grid);
 void printActionTaken(Action action);
 int max_element_index(float* array, int size); // aka argmax
+double secondsSince(const struct timespec *start);
+float sampleLoss(float output[], Action correctAction);
+void checkpointProgress(NeuralNetwork *nn, const TrainOptions *options, int before, int done);
+float maxWeightDifference(NeuralNetwork *a, NeuralNetwork *b);
+bool verifyFusedKernels(NeuralNetwork *nn, const TrainOptions *options);
+void trainSequential(NeuralNetwork *nn, const TrainOptions *options, int start);
+double trainParallel(NeuralNetwork *nn, const TrainOptions *options, int threads, int start, int events, bool report);
+void trainShard(void *ctx, int index);
+void reportScaling(NeuralNetwork *nn, const TrainOptions *options);
+int parseSweepList(const char *list, float values[], const char *name);
+int parseSweepCounts(const char *list, int values[], const char *name);
+void generateSweepChunk(void *ctx, int index);
+void scoreCandidate(SweepCandidate *candidate, const SweepJob *job);
+void runCandidate(void *ctx, int index);
+int compareCandidates(const void *a, const void *b);
+bool runSweep(const TrainOptions *options);
+bool parseTrainOptions(TrainOptions *options, int argc, char **argv);
+
+
+int main(int argc, char **argv) {
+    TrainOptions options = { 1, 0, false, NUM_SIMULATION_EVENTS, 0.1f, (unsigned int)time(NULL), 0, 0, REPORT_INTERVAL, TELEMETRY_FILE,
+                             0, 3, CHECKPOINT_BASE, false, 0, 4, NULL, NULL, NULL, NULL, SWEEP_SAMPLES };
+    if (parseTrainOptions(&options, argc, argv)) return 1;
+    if (initVisionEncoder(&visionEncoder, GRID_SIZE, options.fovea, options.visionRings)) return 1;
+    srand(options.seed);
+    if (options.sweepLearningRates || options.sweepHidden || options.sweepMutationRates || options.sweepMutationMagnitudes)
+        return runSweep(&options);
+
+    NeuralNetwork nn;
+    initializeNetwork(&nn, visionEncoder.inputs, NUM_HIDDEN_LAYER_NEURONS, 5);
+
+    char resumePath[CHECKPOINT_FILE_MAX];
+    CheckpointHeader header;
+    int start = 0; // samples already trained: a resumed run continues with the next sample seed
+    if (!options.resume) {
+        saveLoadNetwork(&nn, visionWeightsFile(&visionEncoder), 'l');
+    } else if (latestCheckpoint(options.checkpoint, resumePath, sizeof(resumePath)) || loadCheckpoint(resumePath, &nn, 1, &header)) {
+        fprintf(stderr, "No usable checkpoint %s.*.ckpt to resume from\n", options.checkpoint);
+        return 1;
+    } else {
+        if (header.seed) options.seed = header.seed; // the samples after the checkpoint come from the run's seed
+        printf("Resumed from %s after %llu samples with seed %u\n", resumePath, (unsigned long long)header.step, options.seed);
+        start = header.step < (uint64_t)options.events ? (int)header.step : options.events;
+    }
+
+    int status = 0;
+    if (options.verifyFused > 0) {
+        status = verifyFusedKernels(&nn, &options);
+    } else if (options.scaling > 0) {
+        reportScaling(&nn, &options);
+    } else {
+        if (openTelemetry(&telemetry, options.telemetry)) return 1;
+        if (options.checkpointEvery && startCheckpointWriter(&checkpoints, options.checkpoint, options.checkpointKeep)) {
+            fprintf(stderr, "Could not start checkpoint writer\n");
+            return 1;
+        }
+        if (start == options.events) {
+            printf("Checkpoint already covers the %d requested samples\n", options.events);
+        } else if (options.threads == 1 && options.batch <= 1 && !options.hogwild) {
+            trainSequential(&nn, &options, start);
+        } else {
+            trainParallel(&nn, &options, options.threads, start, options.events, true);
+        }
+        closeTelemetry(&telemetry);
+        stopCheckpointWriter(&checkpoints);
+        printCheckpointStats(&checkpoints);
+        printf("Loss and accuracy every %d samples appended to %s\n", options.reportInterval, options.telemetry);
+        saveLoadNetwork(&nn, visionWeightsFile(&visionEncoder), 's');
+    }
 
+    // Cleanup
+    cleanupNeuralNetwork(&nn);
+    return status;
+}
 
-int main() {
-    srand(time(NULL));
-    initializeGrid();
+bool parseTrainOptions(TrainOptions *options, int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(arg, "--hogwild") == 0) { options->hogwild = true; continue; }
+        if (strcmp(arg, "--resume") == 0) { options->resume = true; continue; }
+        if (!value || strncmp(arg, "--", 2) != 0) {
+            fprintf(stderr, "Usage: %s [--threads N] [--batch N] [--hogwild] [--events N] [--learning-rate F] [--seed N] [--scaling N] [--verify-fused N] [--telemetry FILE] [--report-interval N]"
+                            " [--checkpoint-every N] [--checkpoint-keep N] [--checkpoint BASE] [--resume]"
+                            " [--fovea N] [--vision-rings N]"
+                            " [--sweep-learning-rate LIST] [--sweep-hidden LIST] [--sweep-mutation-rate LIST] [--sweep-mutation-magnitude LIST]"
+                            " [--sweep-samples N]\n", argv[0]);
+            return true;
+        }
+        if (strcmp(arg, "--threads") == 0) options->threads = atoi(value);
+        else if (strcmp(arg, "--batch") == 0) options->batch = atoi(value);
+        else if (strcmp(arg, "--events") == 0) options->events = atoi(value);
+        else if (strcmp(arg, "--learning-rate") == 0) options->learningRate = (float)atof(value);
+        else if (strcmp(arg, "--seed") == 0) options->seed = (unsigned int)strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--scaling") == 0) options->scaling = atoi(value);
+        else if (strcmp(arg, "--verify-fused") == 0) options->verifyFused = atoi(value);
+        else if (strcmp(arg, "--telemetry") == 0) options->telemetry = value;
+        else if (strcmp(arg, "--report-interval") == 0) options->reportInterval = atoi(value);
+        else if (strcmp(arg, "--checkpoint-every") == 0) options->checkpointEvery = atoi(value);
+        else if (strcmp(arg, "--checkpoint-keep") == 0) options->checkpointKeep = atoi(value);
+        else if (strcmp(arg, "--checkpoint") == 0) options->checkpoint = value;
+        else if (strcmp(arg, "--fovea") == 0) options->fovea = atoi(value);
+        else if (strcmp(arg, "--vision-rings") == 0) options->visionRings = atoi(value);
+        else if (strcmp(arg, "--sweep-learning-rate") == 0) options->sweepLearningRates = value;
+        else if (strcmp(arg, "--sweep-hidden") == 0) options->sweepHidden = value;
+        else if (strcmp(arg, "--sweep-mutation-rate") == 0) options->sweepMutationRates = value;
+        else if (strcmp(arg, "--sweep-mutation-magnitude") == 0) options->sweepMutationMagnitudes = value;
+        else if (strcmp(arg, "--sweep-samples") == 0) options->sweepSamples = atoi(value);
+        else { fprintf(stderr, "Unknown option %s\n", arg); return true; }
+        i++;
+    }
+    if (options->threads < 1 || options->batch < 0 || options->events < 1 || options->reportInterval < 1 ||
+        options->checkpointEvery < 0 || options->checkpointKeep < 1 || options->sweepSamples < 5) {
+        fprintf(stderr, "threads, events, report-interval and checkpoint-keep must be positive, sweep-samples at least 5\n");
+        return true;
+    }
+    return false;
+}
 
-    NeuralNetwork nn;
-    initializeNetwork(&nn, GRID_SIZE * GRID_SIZE, NUM_HIDDEN_LAYER_NEURONS, 5);
+double secondsSince(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
 
-    float learningRate = 0.1 ;
+float sampleLoss(float output[], Action correctAction) {
+    float loss = 0;
+    for(int i = 0; i < 5; i++) {
+        float target = i == (int)correctAction ? 1.0f : 0.0f;
+        loss += (target - output[i]) * (target - output[i]);
+    }
+    return loss;
+}
+
+// hands a copy of nn to the checkpoint writer whenever training crosses a multiple of checkpointEvery
+void checkpointProgress(NeuralNetwork *nn, const TrainOptions *options, int before, int done) {
+    if (options->checkpointEvery && before / options->checkpointEvery != done / options->checkpointEvery)
+        submitCheckpoint(&checkpoints, nn, 1, (uint64_t)done, 0, options->seed);
+}
+
+// plain per-sample SGD on a single thread, FUSED_CHUNK samples at a time through the fused kernel,
+// over samples start to options->events
+void trainSequential(NeuralNetwork *nn, const TrainOptions *options, int start) {
+    static float inputs[FUSED_CHUNK * GRID_SIZE * GRID_SIZE]; // FUSED_CHUNK rows of nn->num_input
+    float targets[FUSED_CHUNK][5];
+    float outputs[FUSED_CHUNK][5];
+    Action correctActions[FUSED_CHUNK];
     int correctCount = 0;
     float totalLoss = 0;
+    int reported = start;
+    struct timespec started;
+    clock_gettime(CLOCK_MONOTONIC, &started);
+
+    for (int first = start; first < options->events; first += FUSED_CHUNK) {
+        int count = options->events - first < FUSED_CHUNK ? options->events - first : FUSED_CHUNK;
+        for (int s = 0; s < count; s++) {
+            generateSample(grid, &inputs[s * nn->num_input], sampleSeed(options->seed, first + s), visionScratch);
+            correctActions[s] = calculateCorrectAction(grid);
+            memset(targets[s], 0, sizeof(targets[s]));
+            targets[s][correctActions[s]] = 1.0f;
+        }
 
-    saveLoadNetwork(&nn, "weights.csv", 'l');
-
-    for (int event = 0; event < NUM_SIMULATION_EVENTS; event++) {
-        initializeGrid();
-
-        for(int i = 0; i < (rand() % 20); i++)
-            spawnFood();
-        
-        // 10% chance to spawn food next to the agent
-        if (rand() % 10 == 0) {
-            int agentX = GRID_SIZE / 2;
-            int agentY = GRID_SIZE / 2;
-            int direction = rand() % 4; // Choose a random direction: up, down, left, or right
-
-            switch (direction) {
-                case 0: // Up
-                    if (agentX > 0) grid[agentX - 1][agentY] = FOOD_VALUE;
-                    break;
-                case 1: // Down
-                    if (agentX < GRID_SIZE - 1) grid[agentX + 1][agentY] = FOOD_VALUE;
-                    break;
-                case 2: // Left
-                    if (agentY > 0) grid[agentX][agentY - 1] = FOOD_VALUE;
-                    break;
-                case 3: // Right
-                    if (agentY < GRID_SIZE - 1) grid[agentX][agentY + 1] = FOOD_VALUE;
-                    break;
+        // Forward, backpropagation and weight updates in one pass per sample
+        trainBatch(nn, inputs, targets[0], count, options->learningRate, outputs[0]);
+        checkpointProgress(nn, options, first, first + count);
+
+        for (int s = 0; s < count; s++) {
+            int event = first + s;
+            Action agentAction = (Action)(max_element_index(outputs[s], 5));
+            Action correctAction = correctActions[s];
+
+            if(agentAction == correctAction) correctCount++;
+            totalLoss += sampleLoss(outputs[s], correctAction);
+
+            // Log stats every reportInterval events
+            int done = event + 1;
+            if(done % options->reportInterval == 0 || done == options->events) {
+                int count = done - reported;
+                TrainingRecord record = { (uint64_t)done, (uint32_t)count, (float)correctCount / count, totalLoss / count, (float)((done - start) / secondsSince(&started)) };
+                logTraining(&telemetry, &record);
+                reported = done;
+                correctCount = 0;
+                totalLoss = 0;
             }
         }
+    }
 
-        float input[GRID_SIZE * GRID_SIZE];
-        for (int i = 0; i < GRID_SIZE; i++)
-            for (int j = 0; j < GRID_SIZE; j++)
-                input[i * GRID_SIZE + j] = (float)(grid[i][j]);
+    double seconds = secondsSince(&started);
+    printf("Trained %d samples in %.2fs: %.0f samples/sec on 1 thread\n", options->events - start, seconds, (options->events - start) / seconds);
+}
 
-        forwardPropagation(&nn, input);
+float maxWeightDifference(NeuralNetwork *a, NeuralNetwork *b) {
+    Layer *layersA[] = {&a->hidden_layer, &a->output_layer};
+    Layer *layersB[] = {&b->hidden_layer, &b->output_layer};
+    int num_weights[] = {a->num_input, a->hidden_layer.num_neurons};
+    float maxDiff = 0;
+
+    for (int l = 0; l < 2; l++) {
+        for (int i = 0; i < layersA[l]->num_neurons; i++) {
+            Neuron *na = &layersA[l]->neurons[i];
+            Neuron *nb = &layersB[l]->neurons[i];
+            for (int j = 0; j < num_weights[l]; j++) maxDiff = fmaxf(maxDiff, fabsf(na->weights[j] - nb->weights[j]));
+            maxDiff = fmaxf(maxDiff, fabsf(na->bias - nb->bias));
+        }
+    }
+    return maxDiff;
+}
+
+// Reference check: trains copies of nn on the same samples with the original
+// forwardPropagation/backwardPropagation/updateWeights sequence, trainStep and trainBatch,
+// and checks inferAction against the argmax of forwardPropagation.
+bool verifyFusedKernels(NeuralNetwork *nn, const TrainOptions *options) {
+    static float inputs[FUSED_CHUNK * GRID_SIZE * GRID_SIZE]; // FUSED_CHUNK rows of nn->num_input
+    float targets[FUSED_CHUNK][5];
+    float outputs[FUSED_CHUNK][5];
+    NeuralNetwork reference, step, batch;
+    NeuralNetwork *copies[] = {&reference, &step, &batch};
+    for (int c = 0; c < 3; c++) {
+        initializeNetwork(copies[c], nn->num_input, nn->hidden_layer.num_neurons, nn->output_layer.num_neurons);
+        copyNeuralNetwork(nn, copies[c]);
+    }
+
+    float *hidden = (float *)malloc(nn->hidden_layer.num_neurons * sizeof(float));
+    if (!hidden) {
+        perror("Memory allocation error");
+        exit(1);
+    }
+    int mismatchedOutputs = 0;
+    int mismatchedActions = 0;
+    int saturatedTies = 0; // equal after the output sigmoid, told apart by inferAction
+    for (int first = 0; first < options->verifyFused; first += FUSED_CHUNK) {
+        int count = options->verifyFused - first < FUSED_CHUNK ? options->verifyFused - first : FUSED_CHUNK;
+        for (int s = 0; s < count; s++) {
+            float *input = &inputs[s * nn->num_input];
+            generateSample(grid, input, sampleSeed(options->seed, first + s), visionScratch);
+            memset(targets[s], 0, sizeof(targets[s]));
+            targets[s][calculateCorrectAction(grid)] = 1.0f;
+
+            forwardPropagation(&reference, input);
+            float referenceOutput[5];
+            for (int i = 0; i < 5; i++) referenceOutput[i] = reference.output_layer.neurons[i].output;
+            int expected = max_element_index(referenceOutput, 5);
+            int inferred = inferAction(&reference, input, hidden);
+            if (inferred != expected) {
+                if (referenceOutput[inferred] == referenceOutput[expected]) saturatedTies++;
+                else mismatchedActions++;
+            }
+            backwardPropagation(&reference, targets[s]);
+            updateWeights(&reference, input, options->learningRate);
+
+            float output[5];
+            trainStep(&step, input, targets[s], options->learningRate, output);
+            for (int i = 0; i < 5; i++)
+                if (output[i] != reference.output_layer.neurons[i].output) mismatchedOutputs++;
+        }
+        trainBatch(&batch, inputs, targets[0], count, options->learningRate, outputs[0]);
+    }
+
+    float stepDiff = maxWeightDifference(&reference, &step);
+    float batchDiff = maxWeightDifference(&reference, &batch);
+    printf("Fused kernels vs three-call sequence over %d samples:\n", options->verifyFused);
+    printf("  trainStep  max weight difference %g, %d output mismatches\n", stepDiff, mismatchedOutputs);
+    printf("  trainBatch max weight difference %g\n", batchDiff);
+    printf("  inferAction %d action mismatches, %d saturated ties resolved\n", mismatchedActions, saturatedTies);
+    for (int c = 0; c < 3; c++) cleanupNeuralNetwork(copies[c]);
+    free(hidden);
+
+    bool failed = stepDiff > VERIFY_TOLERANCE || batchDiff > VERIFY_TOLERANCE || mismatchedActions > 0;
+    printf("%s\n", failed ? "FAILED" : stepDiff == 0 && batchDiff == 0 && mismatchedOutputs == 0 ? "OK (bit-exact)" : "OK (within tolerance)");
+    return failed;
+}
+
+// One task per worker. Synchronous mode accumulates the shard's gradients for a
+// deterministic reduction afterwards; Hogwild mode writes straight into the shared
+// network without locks. Its replica is a view of the shared weights with its own
+// activations and deltas, so a sample only refreshes the replica's biases.
+void trainShard(void *ctx, int index) {
+    TrainJob *job = (TrainJob *)ctx;
+    TrainWorker *worker = &job->workers[index];
+    const TrainOptions *options = job->options;
+    int first = job->first + (int)((long)job->count * index / job->workerCount);
+    int last = job->first + (int)((long)job->count * (index + 1) / job->workerCount);
+
+    if (!options->hogwild) zeroNetwork(worker->gradients);
+    for (int event = first; event < last; event++) {
+        if (options->hogwild) shareNeuralNetwork(job->nn, worker->replica);
+
+        generateSample(worker->grid, worker->input, sampleSeed(options->seed, event), worker->scratch);
+        forwardPropagation(worker->replica, worker->input);
 
         float output[5];
         for (int i = 0; i < 5; i++)
-            output[i] = nn.output_layer.neurons[i].output;
-
-        Action agentAction = (Action)(max_element_index(output, 5));
-        Action correctAction = calculateCorrectAction();
-
-        if (DEBUGGING) {
-            printf("Simulation Event %d\n", event);
-            printf("Agent Accuracy: %f\n", (float)correctCount / (event % 100 + 1));
-            printf("Average Loss: %f\n", totalLoss / (event % 100 + 1));
-            //printf("Grid:\n");
-            //printGrid();
-            printf("Agent Action: ");
-            printActionTaken(agentAction);
-            printf("\nCorrect Action: ");
-            printActionTaken(correctAction);
-            printf("\n\n");
-        }
-
-        if(agentAction == correctAction) correctCount++;
-        float loss = 0;
-        for(int i = 0; i < 5; i++) {
-            float target = i == (int)correctAction ? 1.0f : 0.0f;
-            loss += (target - output[i]) * (target - output[i]);
-        }
-        totalLoss += loss;
-
-        // Print stats every 100 events
-        if(event % 100 == 0) {
-            printf("Simulation Event %d\n", event);
-            printf("Agent Accuracy: %f\n", (float)correctCount / (event % 100 + 1));
-            printf("Average Loss: %f\n", totalLoss / (event % 100 + 1));
-            printf("\n");
-            correctCount = 0;
-            totalLoss = 0;
-        }
-
-        // Backpropagation and weight updates
+            output[i] = worker->replica->output_layer.neurons[i].output;
+        Action correctAction = calculateCorrectAction(worker->grid);
+        if ((Action)max_element_index(output, 5) == correctAction) worker->correctCount++;
+        worker->totalLoss += sampleLoss(output, correctAction);
+
         float target[5] = {0};
         target[correctAction] = 1.0f;
-        backwardPropagation(&nn, target);
-        updateWeights(&nn, input, learningRate);
+        backwardPropagation(worker->replica, target);
+        if (options->hogwild) {
+            updateWeightsFrom(job->nn, worker->replica, worker->input, options->learningRate);
+        } else {
+            accumulateGradients(worker->replica, worker->input, worker->gradients);
+        }
     }
+}
 
-    saveLoadNetwork(&nn, "weights.csv", 's');
+// trains samples start to events, returns samples/sec
+double trainParallel(NeuralNetwork *nn, const TrainOptions *options, int threads, int start, int events, bool report) {
+    ThreadPool pool;
+    NetworkArena replicas, gradients = {0};
+    TrainWorker *workers = (TrainWorker *)calloc(threads, sizeof(TrainWorker));
+    if (!workers || initThreadPool(&pool, threads)) {
+        fprintf(stderr, "Could not start %d training threads\n", threads);
+        exit(1);
+    }
+    bool failed = options->hogwild ? initNetworkViews(&replicas, threads, nn) :
+        initNetworkArena(&replicas, threads, nn->num_input, nn->hidden_layer.num_neurons, nn->output_layer.num_neurons) ||
+        initNetworkArena(&gradients, threads, nn->num_input, nn->hidden_layer.num_neurons, nn->output_layer.num_neurons);
+    if (failed) {
+        perror("Memory allocation error");
+        exit(1);
+    }
+    for (int t = 0; t < threads; t++) {
+        workers[t].replica = &replicas.networks[t];
+        if (options->hogwild) continue;
+        workers[t].gradients = &gradients.networks[t];
+        copyNeuralNetwork(nn, workers[t].replica);
+    }
 
-    // Cleanup
-    for (int i = 0; i < nn.hidden_layer.num_neurons; i++)
-        free(nn.hidden_layer.neurons[i].weights);
-    free(nn.hidden_layer.neurons);
+    TrainJob job = { nn, workers, threads, options, 0, 0 };
+    int round = options->batch ? options->batch : BATCH_PER_THREAD * threads;
+    if (round < threads) round = threads;
+    if (options->hogwild) round = options->reportInterval; // no reduction, rounds only pace the reports and checkpoints
+    int reported = start;
+    struct timespec started;
+    clock_gettime(CLOCK_MONOTONIC, &started);
+
+    for (int event = start; event < events; event += round) {
+        job.first = event;
+        job.count = events - event < round ? events - event : round;
+        runThreadPool(&pool, threads, trainShard, &job);
+
+        if (!options->hogwild) {
+            // reduce in worker order so results do not depend on thread timing
+            for (int t = 0; t < threads; t++) applyGradients(nn, workers[t].gradients, options->learningRate / job.count);
+            for (int t = 0; t < threads; t++) copyNeuralNetwork(nn, workers[t].replica);
+        }
+
+        int done = job.first + job.count;
+        if (report) checkpointProgress(nn, options, job.first, done);
+        if (report && (done - reported >= options->reportInterval || done == events)) {
+            int correctCount = 0;
+            float totalLoss = 0;
+            for (int t = 0; t < threads; t++) {
+                correctCount += workers[t].correctCount;
+                totalLoss += workers[t].totalLoss;
+                workers[t].correctCount = 0;
+                workers[t].totalLoss = 0;
+            }
+            int count = done - reported;
+            TrainingRecord record = { (uint64_t)done, (uint32_t)count, (float)correctCount / count, totalLoss / count, (float)((done - start) / secondsSince(&started)) };
+            logTraining(&telemetry, &record);
+            reported = done;
+        }
+    }
+
+    double samplesPerSecond = (events - start) / secondsSince(&started);
+    if (report) {
+        printf("Trained %d samples in %.2fs: %.0f samples/sec on %d threads (%s)\n", events - start, (events - start) / samplesPerSecond,
+               samplesPerSecond, threads, options->hogwild ? "hogwild" : "synchronous");
+    }
+
+    destroyThreadPool(&pool);
+    cleanupNetworkArena(&replicas);
+    cleanupNetworkArena(&gradients);
+    free(workers);
+    return samplesPerSecond;
+}
+
+// throughput for 1, 2, 4, ... up to options->threads workers, each run from the same starting weights
+void reportScaling(NeuralNetwork *nn, const TrainOptions *options) {
+    NeuralNetwork scratch;
+    initializeNetwork(&scratch, nn->num_input, nn->hidden_layer.num_neurons, nn->output_layer.num_neurons);
+    double baseline = 0;
+
+    printf("threads  samples/sec  speedup\n");
+    for (int threads = 1; ; threads = threads * 2 < options->threads ? threads * 2 : options->threads) {
+        copyNeuralNetwork(nn, &scratch);
+        double rate = trainParallel(&scratch, options, threads, 0, options->scaling, false);
+        if (threads == 1) baseline = rate;
+        printf("%7d  %11.0f  %6.2fx\n", threads, rate, rate / baseline);
+        if (threads == options->threads) break;
+    }
+    cleanupNeuralNetwork(&scratch);
+}
+
+// returns the number of values, 0 if the list is malformed
+int parseSweepList(const char *list, float values[], const char *name) {
+    int count = 0;
+    const char *p = list;
+    while (*p) {
+        char *end;
+        float value = strtof(p, &end);
+        if (end == p || value <= 0 || count == SWEEP_MAX_VALUES || (*end != ',' && *end != '\0')) {
+            fprintf(stderr, "%s takes up to %d positive comma separated values, got \"%s\"\n", name, SWEEP_MAX_VALUES, list);
+            return 0;
+        }
+        values[count++] = value;
+        p = *end ? end + 1 : end;
+    }
+    if (!count) fprintf(stderr, "%s is empty\n", name);
+    return count;
+}
+
+// parseSweepList for whole numbers of at least 1, such as layer sizes
+int parseSweepCounts(const char *list, int values[], const char *name) {
+    int count = 0;
+    const char *p = list;
+    while (*p) {
+        char *end;
+        long value = strtol(p, &end, 10);
+        if (end == p || value < 1 || value > INT_MAX || count == SWEEP_MAX_VALUES || (*end != ',' && *end != '\0')) {
+            fprintf(stderr, "%s takes up to %d comma separated whole numbers of at least 1, got \"%s\"\n", name, SWEEP_MAX_VALUES, list);
+            return 0;
+        }
+        values[count++] = (int)value;
+        p = *end ? end + 1 : end;
+    }
+    if (!count) fprintf(stderr, "%s is empty\n", name);
+    return count;
+}
+
+void generateSweepChunk(void *ctx, int index) {
+    SweepJob *job = (SweepJob *)ctx;
+    Grid sampleGrid;
+    float scratch[VISION_SCRATCH];
+    int last = (index + 1) * SWEEP_GENERATE_CHUNK < job->count ? (index + 1) * SWEEP_GENERATE_CHUNK : job->count;
+    for (int s = index * SWEEP_GENERATE_CHUNK; s < last; s++) {
+        generateSample(sampleGrid, &job->inputs[(size_t)s * job->inputCount], sampleSeed(job->seed, s), scratch);
+        job->actions[s] = (unsigned char)calculateCorrectAction(sampleGrid);
+    }
+}
 
-    for (int i = 0; i < nn.output_layer.num_neurons; i++)
-        free(nn.output_layer.neurons[i].weights);
-    free(nn.output_layer.neurons);
+void scoreCandidate(SweepCandidate *candidate, const SweepJob *job) {
+    int correct = 0;
+    float loss = 0;
+    float output[5];
+    for (int s = job->trainCount; s < job->count; s++) {
+        forwardPropagation(&candidate->nn, &job->inputs[(size_t)s * job->inputCount]);
+        for (int i = 0; i < 5; i++) output[i] = candidate->nn.output_layer.neurons[i].output;
+        if (max_element_index(output, 5) == job->actions[s]) correct++;
+        loss += sampleLoss(output, (Action)job->actions[s]);
+    }
+    candidate->accuracy = (float)correct / (job->count - job->trainCount);
+    candidate->loss = loss / (job->count - job->trainCount);
+}
 
+// one task per candidate, every candidate walks the same training rows in the same order
+void runCandidate(void *ctx, int index) {
+    SweepJob *job = (SweepJob *)ctx;
+    SweepCandidate *candidate = &job->candidates[index];
+    NeuralNetwork *nn = &candidate->nn;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    if (candidate->learningRate > 0) {
+        float targets[FUSED_CHUNK][5];
+        float outputs[FUSED_CHUNK][5];
+        for (int done = 0; done < job->events; ) {
+            int row = done % job->trainCount;
+            int count = job->events - done < FUSED_CHUNK ? job->events - done : FUSED_CHUNK;
+            if (count > job->trainCount - row) count = job->trainCount - row; // rows must be contiguous
+            memset(targets, 0, sizeof(targets));
+            for (int s = 0; s < count; s++) targets[s][job->actions[row + s]] = 1.0f;
+            trainBatch(nn, &job->inputs[(size_t)row * job->inputCount], targets[0], count, candidate->learningRate, outputs[0]);
+            done += count;
+        }
+    } else {
+        // keep a mutated child whenever it does at least as well as its parent on the next batch
+        unsigned int seed = sampleSeed(job->seed, index);
+        float output[5];
+        for (int done = 0; done < job->events; done += SWEEP_EVOLVE_BATCH) {
+            copyNeuralNetwork(nn, &candidate->child);
+            mutateNeuralNetworkSeeded(&candidate->child, candidate->mutationRate, candidate->mutationMagnitude, &seed);
+            float parentLoss = 0, childLoss = 0;
+            for (int s = 0; s < SWEEP_EVOLVE_BATCH; s++) {
+                int row = (done + s) % job->trainCount;
+                float *input = &job->inputs[(size_t)row * job->inputCount];
+                forwardPropagation(nn, input);
+                for (int i = 0; i < 5; i++) output[i] = nn->output_layer.neurons[i].output;
+                parentLoss += sampleLoss(output, (Action)job->actions[row]);
+                forwardPropagation(&candidate->child, input);
+                for (int i = 0; i < 5; i++) output[i] = candidate->child.output_layer.neurons[i].output;
+                childLoss += sampleLoss(output, (Action)job->actions[row]);
+            }
+            if (childLoss <= parentLoss) copyNeuralNetwork(&candidate->child, nn);
+        }
+    }
+
+    scoreCandidate(candidate, job);
+    candidate->seconds = secondsSince(&start);
 }
 
+int compareCandidates(const void *a, const void *b) {
+    const SweepCandidate *x = (const SweepCandidate *)a;
+    const SweepCandidate *y = (const SweepCandidate *)b;
+    if (x->accuracy != y->accuracy) return x->accuracy < y->accuracy ? 1 : -1;
+    return (x->loss > y->loss) - (x->loss < y->loss);
+}
 
+// Trains or evolves every combination of the sweep grids concurrently on one
+// dataset, generated once, and prints the candidates by held-out accuracy.
+bool runSweep(const TrainOptions *options) {
+    float rates[SWEEP_MAX_VALUES] = { options->learningRate };
+    int hidden[SWEEP_MAX_VALUES] = { NUM_HIDDEN_LAYER_NEURONS };
+    float mutationRates[SWEEP_MAX_VALUES] = { 0.1f };
+    float mutationMagnitudes[SWEEP_MAX_VALUES] = { 0.01f };
+    int rateCount = 1, hiddenCount = 1, mutationRateCount = 1, mutationMagnitudeCount = 1;
+    bool evolve = options->sweepMutationRates || options->sweepMutationMagnitudes;
+    if (evolve && options->sweepLearningRates) {
+        fprintf(stderr, "a sweep either trains (--sweep-learning-rate) or evolves (--sweep-mutation-*), not both\n");
+        return true;
+    }
+    if ((options->sweepLearningRates && !(rateCount = parseSweepList(options->sweepLearningRates, rates, "--sweep-learning-rate"))) ||
+        (options->sweepHidden && !(hiddenCount = parseSweepCounts(options->sweepHidden, hidden, "--sweep-hidden"))) ||
+        (options->sweepMutationRates && !(mutationRateCount = parseSweepList(options->sweepMutationRates, mutationRates, "--sweep-mutation-rate"))) ||
+        (options->sweepMutationMagnitudes && !(mutationMagnitudeCount = parseSweepList(options->sweepMutationMagnitudes, mutationMagnitudes, "--sweep-mutation-magnitude"))))
+        return true;
+    if (!evolve) mutationRateCount = mutationMagnitudeCount = 1;
+    else rateCount = 1;
+
+    SweepJob job = { NULL, NULL, options->sweepSamples, options->sweepSamples - options->sweepSamples / 5, visionEncoder.inputs,
+                     options->seed, NULL, options->events };
+    int candidateCount = hiddenCount * (evolve ? mutationRateCount * mutationMagnitudeCount : rateCount);
+    job.inputs = (float *)malloc((size_t)job.count * job.inputCount * sizeof(float));
+    job.actions = (unsigned char *)malloc(job.count);
+    job.candidates = (SweepCandidate *)calloc(candidateCount, sizeof(SweepCandidate));
+    ThreadPool pool;
+    if (!job.inputs || !job.actions || !job.candidates || initThreadPool(&pool, options->threads)) {
+        fprintf(stderr, "Could not allocate a %d sample sweep dataset\n", job.count);
+        return true;
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    runThreadPool(&pool, (job.count + SWEEP_GENERATE_CHUNK - 1) / SWEEP_GENERATE_CHUNK, generateSweepChunk, &job);
+    printf("Generated %d samples (%.1f MB) in %.2fs\n", job.count, (double)job.count * job.inputCount * sizeof(float) / (1 << 20),
+           secondsSince(&start));
+
+    // candidates of the same hidden size start from the same weights, so only the swept values differ
+    int c = 0;
+    for (int h = 0; h < hiddenCount; h++) {
+        for (int a = 0; a < (evolve ? mutationRateCount : rateCount); a++) {
+            for (int b = 0; b < (evolve ? mutationMagnitudeCount : 1); b++, c++) {
+                SweepCandidate *candidate = &job.candidates[c];
+                candidate->hidden = hidden[h];
+                candidate->learningRate = evolve ? 0 : rates[a];
+                candidate->mutationRate = evolve ? mutationRates[a] : 0;
+                candidate->mutationMagnitude = evolve ? mutationMagnitudes[b] : 0;
+                srand(options->seed);
+                initializeNetwork(&candidate->nn, job.inputCount, candidate->hidden, 5);
+                if (evolve) initializeNetwork(&candidate->child, job.inputCount, candidate->hidden, 5);
+            }
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    runThreadPool(&pool, candidateCount, runCandidate, &job);
+    double seconds = secondsSince(&start);
+    qsort(job.candidates, candidateCount, sizeof(SweepCandidate), compareCandidates);
+
+    printf("%d candidates x %d samples on %d threads in %.2fs, scored on %d held-out samples\n", candidateCount, job.events,
+           options->threads, seconds, job.count - job.trainCount);
+    printf(evolve ? "rank  hidden  mutation-rate  magnitude  accuracy    loss  seconds\n"
+                  : "rank  hidden  learning-rate  accuracy    loss  seconds\n");
+    for (c = 0; c < candidateCount; c++) {
+        SweepCandidate *candidate = &job.candidates[c];
+        if (evolve) {
+            printf("%4d  %6d  %13g  %9g  %8.4f  %6.4f  %7.2f\n", c + 1, candidate->hidden, candidate->mutationRate,
+                   candidate->mutationMagnitude, candidate->accuracy, candidate->loss, candidate->seconds);
+        } else {
+            printf("%4d  %6d  %13g  %8.4f  %6.4f  %7.2f\n", c + 1, candidate->hidden, candidate->learningRate,
+                   candidate->accuracy, candidate->loss, candidate->seconds);
+        }
+        cleanupNeuralNetwork(&candidate->nn);
+        if (evolve) cleanupNeuralNetwork(&candidate->child);
+    }
+
+    destroyThreadPool(&pool);
+    free(job.inputs);
+    free(job.actions);
+    free(job.candidates);
+    return false;
+}
 
 
 
@@ -211,7 +827,9 @@ int main() {
 
 
 
-void printGrid() {
+
+
+void printGrid(Grid grid) {
     for (int i = 0; i < GRID_SIZE; i++) {
         for (int j = 0; j < GRID_SIZE; j++) {
             if (grid[i][j] == FOOD_VALUE) {
@@ -228,7 +846,6 @@ void printGrid() {
     }
     printf("\n");
 }
-
 void printActionTaken(Action action) {
     switch (action) {
         case DO_NOTHING:
@@ -0,0 +1,97 @@
+#include "sim_channel.h"
+#include "alloc_stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+bool initSnapshotExchange(SnapshotExchange *ex, int snakeCount) {
+    memset(ex, 0, sizeof(*ex));
+    for (int i = 0; i < 3; i++) {
+        ex->slots[i].snakeCount = snakeCount;
+        ex->slots[i].snakes = (SnakeView *)statCalloc(ALLOC_SNAPSHOTS, snakeCount, sizeof(SnakeView));
+        if (!ex->slots[i].snakes) {
+            destroySnapshotExchange(ex);
+            return true;
+        }
+    }
+    ex->back = &ex->slots[0];
+    ex->middle = &ex->slots[1];
+    ex->front = &ex->slots[2];
+    SDL_AtomicSet(&ex->fresh, 0);
+    ex->lock = SDL_CreateMutex();
+    if (!ex->lock) {
+        destroySnapshotExchange(ex);
+        return true;
+    }
+    return false;
+}
+
+void destroySnapshotExchange(SnapshotExchange *ex) {
+    for (int i = 0; i < 3; i++) {
+        statFree(ALLOC_SNAPSHOTS, ex->slots[i].snakes, ex->slots[i].snakeCount * sizeof(SnakeView));
+        statFree(ALLOC_SNAPSHOTS, ex->slots[i].changes, ex->slots[i].changeCapacity * sizeof(CellChange));
+    }
+    if (ex->lock) SDL_DestroyMutex(ex->lock);
+    memset(ex, 0, sizeof(*ex));
+}
+
+void recordCellChange(SnapshotExchange *ex, int x, int y, float previous, float value) {
+    WorldSnapshot *snap = ex->back;
+    if (snap->changeCount == snap->changeCapacity) {
+        int capacity = snap->changeCapacity ? snap->changeCapacity * 2 : 1024;
+        CellChange *changes = (CellChange *)statRealloc(ALLOC_SNAPSHOTS, snap->changes, snap->changeCapacity * sizeof(CellChange), capacity * sizeof(CellChange));
+        if (changes == NULL) {
+            perror("Memory allocation error");
+            exit(1);
+        }
+        snap->changes = changes;
+        snap->changeCapacity = capacity;
+    }
+    CellChange *c = &snap->changes[snap->changeCount++];
+    c->x = x;
+    c->y = y;
+    c->previous = previous;
+    c->value = value;
+}
+
+bool snapshotConsumed(SnapshotExchange *ex) {
+    return SDL_AtomicGet(&ex->fresh) == 0;
+}
+
+void publishSnapshot(SnapshotExchange *ex) {
+    SDL_LockMutex(ex->lock);
+    WorldSnapshot *published = ex->back;
+    ex->back = ex->middle;
+    ex->middle = published;
+    SDL_AtomicSet(&ex->fresh, 1);
+    SDL_UnlockMutex(ex->lock);
+    ex->back->changeCount = 0; // the reader is done with it
+}
+
+WorldSnapshot *acquireSnapshot(SnapshotExchange *ex) {
+    if (SDL_AtomicGet(&ex->fresh) == 0) return NULL;
+    SDL_LockMutex(ex->lock);
+    WorldSnapshot *latest = ex->middle;
+    ex->middle = ex->front;
+    ex->front = latest;
+    SDL_AtomicSet(&ex->fresh, 0);
+    SDL_UnlockMutex(ex->lock);
+    return latest;
+}
+
+bool postCommand(CommandQueue *queue, SimCommand cmd) {
+    int head = SDL_AtomicGet(&queue->head);
+    if (head - SDL_AtomicGet(&queue->tail) == COMMAND_QUEUE_SIZE) return false;
+    queue->commands[head & (COMMAND_QUEUE_SIZE - 1)] = cmd;
+    SDL_AtomicSet(&queue->head, head + 1);
+    return true;
+}
+
+bool pollCommand(CommandQueue *queue, SimCommand *cmd) {
+    int tail = SDL_AtomicGet(&queue->tail);
+    if (tail == SDL_AtomicGet(&queue->head)) return false;
+    *cmd = queue->commands[tail & (COMMAND_QUEUE_SIZE - 1)];
+    SDL_AtomicSet(&queue->tail, tail + 1);
+    return true;
+}
@@ -0,0 +1,75 @@
+#ifndef SIM_CHANNEL_H
+#define SIM_CHANNEL_H
+
+#include <SDL2/SDL.h>
+#include <stdbool.h>
+
+#define COMMAND_QUEUE_SIZE 64 // power of two
+
+// Hand-off between the simulation thread (writer) and the render thread (reader).
+// The sim fills its back snapshot and publishes it only once the reader has taken
+// the previous one, so cell changes accumulate instead of being dropped and
+// neither side ever waits on the other.
+
+typedef enum {
+    CMD_RATE_UP,
+    CMD_RATE_DOWN,
+    CMD_MAGNITUDE_UP,
+    CMD_MAGNITUDE_DOWN,
+    CMD_SAVE,
+    CMD_LOAD,
+    CMD_EVOLVE,
+    CMD_MUTATE,
+} SimCommand;
+
+typedef struct CellChange {
+    int x, y;
+    float previous; // grid value before the change
+    float value;
+} CellChange;
+
+typedef struct SnakeView {
+    int x, y;
+    int foodsEaten;
+} SnakeView;
+
+typedef struct WorldSnapshot {
+    unsigned long tick;
+    int evolutionEvents;
+    float mutationRate;
+    float mutationMagnitude;
+    float ticksPerSecond;
+    int snakeCount;
+    SnakeView *snakes;
+    int changeCount;
+    int changeCapacity;
+    CellChange *changes; // every cell change since the previous published snapshot
+} WorldSnapshot;
+
+typedef struct SnapshotExchange {
+    WorldSnapshot slots[3];
+    WorldSnapshot *back;   // written by the sim thread
+    WorldSnapshot *middle; // last published
+    WorldSnapshot *front;  // read by the render thread
+    SDL_atomic_t fresh;    // 1 while middle has not been taken by the reader
+    SDL_mutex *lock;
+} SnapshotExchange;
+
+// single producer (render thread), single consumer (sim thread)
+typedef struct CommandQueue {
+    SimCommand commands[COMMAND_QUEUE_SIZE];
+    SDL_atomic_t head;
+    SDL_atomic_t tail;
+} CommandQueue;
+
+bool initSnapshotExchange(SnapshotExchange *ex, int snakeCount); // true on error
+void destroySnapshotExchange(SnapshotExchange *ex);
+void recordCellChange(SnapshotExchange *ex, int x, int y, float previous, float value);
+bool snapshotConsumed(SnapshotExchange *ex);
+void publishSnapshot(SnapshotExchange *ex);
+WorldSnapshot *acquireSnapshot(SnapshotExchange *ex); // NULL if nothing new was published
+
+bool postCommand(CommandQueue *queue, SimCommand cmd); // false if the queue is full
+bool pollCommand(CommandQueue *queue, SimCommand *cmd);
+
+#endif // SIM_CHANNEL_H
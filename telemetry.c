@@ -0,0 +1,124 @@
+#include "telemetry.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    uint32_t type;
+    uint32_t size;
+} RecordFrame;
+
+
+bool openTelemetry(TelemetryLog *log, const char *path) {
+    log->used = 0;
+    log->file = fopen(path, "a+b"); // writes always append, reads check an existing header
+    if (!log->file) {
+        fprintf(stderr, "Could not open telemetry log %s\n", path);
+        return true;
+    }
+    fseek(log->file, 0, SEEK_END);
+    if (ftell(log->file) != 0) {
+        rewind(log->file);
+        if (readTelemetryHeader(log->file)) {
+            fprintf(stderr, "%s exists and is not a version %d telemetry log, not appending to it\n", path, TELEMETRY_VERSION);
+            fclose(log->file);
+            log->file = NULL;
+            return true;
+        }
+        fseek(log->file, 0, SEEK_END); // a+ needs a positioning call between reading and writing
+    } else {
+        uint32_t version = TELEMETRY_VERSION;
+        memcpy(log->buffer, TELEMETRY_MAGIC, 4);
+        memcpy(log->buffer + 4, &version, sizeof(version));
+        log->used = 8;
+    }
+    return false;
+}
+
+void flushTelemetry(TelemetryLog *log) {
+    if (!log->file) return;
+    if (log->used) fwrite(log->buffer, 1, log->used, log->file);
+    log->used = 0;
+    fflush(log->file);
+}
+
+void closeTelemetry(TelemetryLog *log) {
+    if (!log->file) return;
+    flushTelemetry(log);
+    fclose(log->file);
+    log->file = NULL;
+}
+
+// copies a record into the buffer, writing the buffer out only when it fills up
+static void appendRecord(TelemetryLog *log, uint32_t type, const void *head, size_t headSize, const void *tail, size_t tailSize) {
+    RecordFrame frame = { type, (uint32_t)(headSize + tailSize) };
+    size_t total = sizeof(frame) + frame.size;
+    if (log->used + total > TELEMETRY_BUFFER_SIZE) {
+        fwrite(log->buffer, 1, log->used, log->file);
+        log->used = 0;
+    }
+    if (total > TELEMETRY_BUFFER_SIZE) { // larger than the whole buffer, write through
+        fwrite(&frame, sizeof(frame), 1, log->file);
+        fwrite(head, 1, headSize, log->file);
+        fwrite(tail, 1, tailSize, log->file);
+        return;
+    }
+    unsigned char *dst = log->buffer + log->used;
+    memcpy(dst, &frame, sizeof(frame));
+    memcpy(dst + sizeof(frame), head, headSize);
+    if (tailSize) memcpy(dst + sizeof(frame) + headSize, tail, tailSize);
+    log->used += total;
+}
+
+void logGeneration(TelemetryLog *log, const GenerationRecord *record, const float fitness[]) {
+    if (!log->file) return;
+    appendRecord(log, TELEMETRY_GENERATION, record, sizeof(*record), fitness, record->snakeCount * sizeof(float));
+}
+
+void logTraining(TelemetryLog *log, const TrainingRecord *record) {
+    if (!log->file) return;
+    appendRecord(log, TELEMETRY_TRAINING, record, sizeof(*record), NULL, 0);
+}
+
+void logCulling(TelemetryLog *log, const CullingRecord *record) {
+    if (!log->file) return;
+    appendRecord(log, TELEMETRY_CULLING, record, sizeof(*record), NULL, 0);
+}
+
+bool readTelemetryHeader(FILE *file) {
+    char magic[4];
+    uint32_t version;
+    if (fread(magic, 1, 4, file) != 4 || memcmp(magic, TELEMETRY_MAGIC, 4) != 0) return true;
+    if (fread(&version, sizeof(version), 1, file) != 1 || version != TELEMETRY_VERSION) return true;
+    return false;
+}
+
+bool readTelemetryRecord(FILE *file, TelemetryRecord *record) {
+    RecordFrame frame;
+    while (fread(&frame, sizeof(frame), 1, file) == 1) {
+        record->type = frame.type;
+        switch (frame.type) {
+            case TELEMETRY_GENERATION: {
+                if (frame.size < sizeof(GenerationRecord) ||
+                    fread(&record->generation, sizeof(GenerationRecord), 1, file) != 1) return false;
+                uint32_t count = record->generation.snakeCount;
+                if (frame.size != sizeof(GenerationRecord) + count * sizeof(float)) return false;
+                if (count > record->fitnessCapacity) {
+                    float *grown = (float *)realloc(record->fitness, count * sizeof(float));
+                    if (!grown) return false;
+                    record->fitness = grown;
+                    record->fitnessCapacity = count;
+                }
+                return fread(record->fitness, sizeof(float), count, file) == count;
+            }
+            case TELEMETRY_TRAINING:
+                if (frame.size != sizeof(TrainingRecord)) return false;
+                return fread(&record->training, sizeof(TrainingRecord), 1, file) == 1;
+            case TELEMETRY_CULLING:
+                if (frame.size != sizeof(CullingRecord)) return false;
+                return fread(&record->culling, sizeof(CullingRecord), 1, file) == 1;
+            default:
+                if (fseek(file, frame.size, SEEK_CUR) != 0) return false;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,78 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Append-only binary run log: an 8 byte file header, then framed records
+// (type, payload size, payload). Fields are fixed-width and written in host
+// byte order; readers skip record types they do not know.
+#define TELEMETRY_MAGIC "SNTL"
+#define TELEMETRY_VERSION 1
+#define TELEMETRY_BUFFER_SIZE 65536
+
+typedef enum {
+    TELEMETRY_GENERATION = 1,
+    TELEMETRY_TRAINING = 2,
+    TELEMETRY_CULLING = 3,
+} TelemetryRecordType;
+
+// followed in the file by snakeCount floats, the fitness column
+typedef struct {
+    uint64_t tick;
+    uint32_t generation;
+    uint32_t snakeCount;
+    int32_t champion; // -1 when no snake ate this generation
+    float mutationRate;
+    float mutationMagnitude;
+    float ticksPerSecond;
+} GenerationRecord;
+
+// loss and accuracy over the `count` samples ending at `sample`
+typedef struct {
+    uint64_t sample;
+    uint32_t count;
+    float accuracy;
+    float loss;
+    float samplesPerSecond;
+} TrainingRecord;
+
+// snakes whose evaluation stopped early during one generation, by reason
+typedef struct {
+    uint64_t skippedSnakeTicks; // evaluations saved by not running culled snakes
+    uint32_t generation;
+    uint32_t idle;
+    uint32_t stagnant;
+    uint32_t dominated;
+    uint32_t respawned;
+    uint32_t reserved;
+} CullingRecord;
+
+typedef struct {
+    FILE *file; // NULL: logging disabled, every call is a no-op
+    size_t used;
+    unsigned char buffer[TELEMETRY_BUFFER_SIZE];
+} TelemetryLog;
+
+typedef struct {
+    uint32_t type;
+    GenerationRecord generation;
+    TrainingRecord training;
+    CullingRecord culling;
+    float *fitness; // grown as needed, free() when done
+    uint32_t fitnessCapacity;
+} TelemetryRecord;
+
+bool openTelemetry(TelemetryLog *log, const char *path); // true on error, appends to an existing log, refuses any other file
+void logGeneration(TelemetryLog *log, const GenerationRecord *record, const float fitness[]);
+void logTraining(TelemetryLog *log, const TrainingRecord *record);
+void logCulling(TelemetryLog *log, const CullingRecord *record);
+void flushTelemetry(TelemetryLog *log);
+void closeTelemetry(TelemetryLog *log);
+
+bool readTelemetryHeader(FILE *file); // true if the file is not a telemetry log
+bool readTelemetryRecord(FILE *file, TelemetryRecord *record); // false at end of file or on a truncated record
+
+#endif // TELEMETRY_H
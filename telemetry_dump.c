@@ -0,0 +1,71 @@
+#include "telemetry.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Exports one record type of a telemetry log as CSV on stdout.
+int main(int argc, char **argv) {
+    if (argc != 3 || (strcmp(argv[2], "generations") != 0 && strcmp(argv[2], "training") != 0 && strcmp(argv[2], "culling") != 0)) {
+        fprintf(stderr, "Usage: %s LOG generations|training|culling > out.csv\n", argv[0]);
+        return 1;
+    }
+    FILE *file = fopen(argv[1], "rb");
+    if (!file) {
+        fprintf(stderr, "Could not open %s\n", argv[1]);
+        return 1;
+    }
+    if (readTelemetryHeader(file)) {
+        fprintf(stderr, "%s is not a telemetry log\n", argv[1]);
+        fclose(file);
+        return 1;
+    }
+
+    bool generations = strcmp(argv[2], "generations") == 0;
+    bool culling = strcmp(argv[2], "culling") == 0;
+    TelemetryRecord record = {0};
+    uint32_t columns = 0;
+    long rows = 0;
+    if (generations) {
+        // first pass sizes the fitness columns for the largest population in the log
+        long start = ftell(file);
+        while (readTelemetryRecord(file, &record))
+            if (record.type == TELEMETRY_GENERATION && record.generation.snakeCount > columns) columns = record.generation.snakeCount;
+        clearerr(file);
+        fseek(file, start, SEEK_SET);
+        printf("generation,tick,champion,mutation_rate,mutation_magnitude,ticks_per_second");
+        for (uint32_t s = 0; s < columns; s++) printf(",fitness_%u", s);
+        printf("\n");
+    } else if (culling) {
+        printf("generation,idle,stagnant,dominated,respawned,skipped_snake_ticks\n");
+    } else {
+        printf("sample,count,accuracy,loss,samples_per_second\n");
+    }
+
+    while (readTelemetryRecord(file, &record)) {
+        if (generations && record.type == TELEMETRY_GENERATION) {
+            const GenerationRecord *g = &record.generation;
+            printf("%u,%llu,%d,%g,%g,%g", g->generation, (unsigned long long)g->tick, g->champion,
+                   g->mutationRate, g->mutationMagnitude, g->ticksPerSecond);
+            for (uint32_t s = 0; s < columns; s++) {
+                if (s < g->snakeCount) printf(",%g", record.fitness[s]);
+                else printf(",");
+            }
+            printf("\n");
+            rows++;
+        } else if (culling && record.type == TELEMETRY_CULLING) {
+            const CullingRecord *c = &record.culling;
+            printf("%u,%u,%u,%u,%u,%llu\n", c->generation, c->idle, c->stagnant, c->dominated, c->respawned,
+                   (unsigned long long)c->skippedSnakeTicks);
+            rows++;
+        } else if (!generations && !culling && record.type == TELEMETRY_TRAINING) {
+            const TrainingRecord *t = &record.training;
+            printf("%llu,%u,%g,%g,%g\n", (unsigned long long)t->sample, t->count, t->accuracy, t->loss, t->samplesPerSecond);
+            rows++;
+        }
+    }
+    if (!feof(file)) fprintf(stderr, "Stopped at a truncated or corrupt record after %ld rows\n", rows);
+
+    free(record.fitness);
+    fclose(file);
+    return 0;
+}
@@ -0,0 +1,80 @@
+#include "thread_pool.h"
+#include "alloc_stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+
+// runs tasks of the current job until none are left, called with the lock held
+static void drainTasks(ThreadPool *pool) {
+    while (pool->nextTask < pool->taskCount) {
+        int index = pool->nextTask++;
+        pthread_mutex_unlock(&pool->lock);
+        pool->task(pool->ctx, index);
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->unfinished == 0) pthread_cond_broadcast(&pool->workDone);
+    }
+}
+
+static void *poolWorker(void *arg) {
+    ThreadPool *pool = (ThreadPool *)arg;
+    unsigned long seenJob = 0;
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (!pool->stopping && pool->job == seenJob) pthread_cond_wait(&pool->workReady, &pool->lock);
+        if (pool->stopping) break;
+        seenJob = pool->job;
+        drainTasks(pool);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+bool initThreadPool(ThreadPool *pool, int threadCount) {
+    pool->threadCount = threadCount < 1 ? 1 : threadCount;
+    pool->taskCount = pool->nextTask = pool->unfinished = 0;
+    pool->job = 0;
+    pool->stopping = false;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->workReady, NULL);
+    pthread_cond_init(&pool->workDone, NULL);
+
+    pool->allocatedThreads = pool->threadCount;
+    pool->threads = (pthread_t *)statMalloc(ALLOC_THREADS, pool->allocatedThreads * sizeof(pthread_t));
+    if (!pool->threads) return true;
+    for (int i = 1; i < pool->threadCount; i++) {
+        if (pthread_create(&pool->threads[i], NULL, poolWorker, pool) != 0) {
+            fprintf(stderr, "Could not start worker thread %d\n", i);
+            pool->threadCount = i; // join the ones that did start
+            destroyThreadPool(pool);
+            return true;
+        }
+    }
+    return false;
+}
+
+void runThreadPool(ThreadPool *pool, int taskCount, PoolTask task, void *ctx) {
+    pthread_mutex_lock(&pool->lock);
+    pool->task = task;
+    pool->ctx = ctx;
+    pool->taskCount = taskCount;
+    pool->nextTask = 0;
+    pool->unfinished = taskCount;
+    pool->job++;
+    pthread_cond_broadcast(&pool->workReady);
+    drainTasks(pool);
+    while (pool->unfinished > 0) pthread_cond_wait(&pool->workDone, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void destroyThreadPool(ThreadPool *pool) {
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->workReady);
+    pthread_mutex_unlock(&pool->lock);
+    for (int i = 1; i < pool->threadCount; i++) pthread_join(pool->threads[i], NULL);
+    statFree(ALLOC_THREADS, pool->threads, pool->allocatedThreads * sizeof(pthread_t));
+    pool->threads = NULL;
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->workReady);
+    pthread_cond_destroy(&pool->workDone);
+}
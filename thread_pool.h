@@ -0,0 +1,31 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <pthread.h>
+#include <stdbool.h>
+
+typedef void (*PoolTask)(void *ctx, int index);
+
+// Fixed set of worker threads running parallel-for style jobs. The calling thread
+// takes part as well, so a pool of threadCount uses threadCount - 1 extra threads.
+typedef struct ThreadPool {
+    int threadCount;
+    pthread_t *threads;
+    int allocatedThreads; // entries in threads, threadCount drops if a worker fails to start
+    pthread_mutex_t lock;
+    pthread_cond_t workReady;
+    pthread_cond_t workDone;
+    PoolTask task;
+    void *ctx;
+    int taskCount;
+    int nextTask;
+    int unfinished;
+    unsigned long job; // bumped for every runThreadPool call
+    bool stopping;
+} ThreadPool;
+
+bool initThreadPool(ThreadPool *pool, int threadCount); // true on error
+void runThreadPool(ThreadPool *pool, int taskCount, PoolTask task, void *ctx); // returns once every task ran
+void destroyThreadPool(ThreadPool *pool);
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,113 @@
+#include "vision.h"
+#include <stdio.h>
+#include <string.h>
+
+#define MAX_RINGS (int)(sizeof(((VisionEncoder *)0)->ringEdge) / sizeof(int))
+
+
+bool initVisionEncoder(VisionEncoder *encoder, int window, int fovea, int rings) {
+    memset(encoder, 0, sizeof(*encoder));
+    encoder->window = window;
+    if (fovea == 0 || fovea == window) {
+        encoder->inputs = window * window;
+        return false;
+    }
+
+    int half = window / 2;
+    int foveaHalf = fovea / 2;
+    if (fovea < 1 || fovea % 2 == 0 || fovea > window) {
+        fprintf(stderr, "fovea must be odd and at most the window size %d\n", window);
+        return true;
+    }
+    if (rings < 1 || rings > MAX_RINGS || rings > half - foveaHalf) {
+        fprintf(stderr, "rings must be between 1 and %d for a %d window with a %d fovea\n",
+                half - foveaHalf < MAX_RINGS ? half - foveaHalf : MAX_RINGS, window, fovea);
+        return true;
+    }
+    encoder->fovea = fovea;
+    encoder->rings = rings;
+    encoder->inputs = fovea * fovea + rings * VISION_SECTORS * VISION_CHANNELS;
+
+    // ring widths double outwards: detail near the fovea, coarse summaries at the edge
+    int span = half - foveaHalf;
+    long total = (1L << rings) - 1;
+    int previous = foveaHalf;
+    for (int r = 0; r < rings; r++) {
+        int edge = foveaHalf + (int)((span * ((1L << (r + 1)) - 1) + total / 2) / total);
+        if (edge <= previous) edge = previous + 1; // every ring at least one cell wide
+        if (edge > half - (rings - 1 - r)) edge = half - (rings - 1 - r);
+        encoder->ringEdge[r] = edge;
+        previous = edge;
+    }
+    return false;
+}
+
+size_t visionScratchSize(const VisionEncoder *encoder) {
+    if (!encoder->fovea) return 0;
+    size_t side = encoder->window + 1;
+    return 2 * side * side;
+}
+
+// count of cells in [x0, x1] x [y0, y1] (inclusive) from a (window + 1)^2 summed-area table
+static inline float areaSum(const float *table, int stride, int x0, int y0, int x1, int y1) {
+    return table[(y1 + 1) * stride + x1 + 1] - table[y0 * stride + x1 + 1] - table[(y1 + 1) * stride + x0] + table[y0 * stride + x0];
+}
+
+void encodeVision(const VisionEncoder *encoder, const float *roi, float *input, float *scratch) {
+    int window = encoder->window;
+    if (!encoder->fovea) {
+        memcpy(input, roi, (size_t)window * window * sizeof(float));
+        return;
+    }
+
+    int stride = window + 1;
+    float *food = scratch;
+    float *walls = scratch + (size_t)stride * stride;
+    memset(food, 0, stride * sizeof(float));
+    memset(walls, 0, stride * sizeof(float));
+    for (int y = 0; y < window; y++) {
+        const float *row = roi + (size_t)y * window;
+        float *foodRow = food + (size_t)(y + 1) * stride;
+        float *wallRow = walls + (size_t)(y + 1) * stride;
+        float foodRun = 0, wallRun = 0;
+        foodRow[0] = wallRow[0] = 0;
+        for (int x = 0; x < window; x++) {
+            foodRun += row[x] > 0;
+            wallRun += row[x] < 0;
+            foodRow[x + 1] = foodRow[x + 1 - stride] + foodRun;
+            wallRow[x + 1] = wallRow[x + 1 - stride] + wallRun;
+        }
+    }
+
+    int centre = window / 2;
+    int foveaHalf = encoder->fovea / 2;
+    for (int y = -foveaHalf; y <= foveaHalf; y++) {
+        memcpy(input, roi + (size_t)(centre + y) * window + centre - foveaHalf, encoder->fovea * sizeof(float));
+        input += encoder->fovea;
+    }
+
+    int inner = foveaHalf;
+    for (int r = 0; r < encoder->rings; r++) {
+        int outer = encoder->ringEdge[r];
+        // columns and rows of the ring's 3x3 split: before, across and after the inner square
+        int lo[3] = { centre - outer, centre - inner, centre + inner + 1 };
+        int hi[3] = { centre - inner - 1, centre + inner, centre + outer };
+        for (int sy = 0; sy < 3; sy++) {
+            for (int sx = 0; sx < 3; sx++) {
+                if (sx == 1 && sy == 1) continue;
+                float area = (float)((hi[sx] - lo[sx] + 1) * (hi[sy] - lo[sy] + 1));
+                *input++ = areaSum(food, stride, lo[sx], lo[sy], hi[sx], hi[sy]) / area;
+                *input++ = areaSum(walls, stride, lo[sx], lo[sy], hi[sx], hi[sy]) / area;
+            }
+        }
+        inner = outer;
+    }
+}
+
+// networks for different input layouts cannot share a CSV file
+const char *visionWeightsFile(const VisionEncoder *encoder) {
+    static char name[64];
+    if (!encoder->fovea) return "weights.csv";
+    snprintf(name, sizeof(name), "weights_w%df%dr%d.csv", encoder->window, encoder->fovea, encoder->rings);
+    return name;
+}
@@ -0,0 +1,29 @@
+#ifndef VISION_H
+#define VISION_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define VISION_SECTORS 8
+#define VISION_CHANNELS 2 // food and obstacle (any negative cell) density per sector
+
+// Turns a square window of cells into network inputs. With a fovea the centre
+// fovea x fovea cells are copied as they are and the rest of the window is cut
+// into square rings of growing width, each split into 8 sectors (the 3x3 grid of
+// the ring minus its middle) that contribute their food and wall densities.
+// Densities come from summed-area tables, so each sector costs four lookups.
+// fovea 0 keeps the window at full resolution.
+typedef struct VisionEncoder {
+    int window; // side of the window, odd
+    int fovea;  // side of the full-resolution centre, odd and < window, or 0
+    int rings;
+    int inputs; // encoded length
+    int ringEdge[32]; // outer half-extent of each ring
+} VisionEncoder;
+
+bool initVisionEncoder(VisionEncoder *encoder, int window, int fovea, int rings); // true if the layout is invalid
+size_t visionScratchSize(const VisionEncoder *encoder); // floats of scratch encodeVision needs
+void encodeVision(const VisionEncoder *encoder, const float *roi, float *input, float *scratch); // roi is window x window, row-major
+const char *visionWeightsFile(const VisionEncoder *encoder); // weights.csv, or a name per foveated layout
+
+#endif // VISION_H
@@ -0,0 +1,63 @@
+#include "world.h"
+#include "alloc_stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+bool initWorld(World *world, int size) {
+    world->size = size;
+    world->chunksPerSide = (size + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    world->allocatedChunks = 0;
+    world->chunks = (float **)statCalloc(ALLOC_WORLD, (size_t)world->chunksPerSide * world->chunksPerSide, sizeof(float *));
+    return world->chunks == NULL;
+}
+
+void freeWorld(World *world) {
+    if (!world->chunks) return;
+    size_t chunkCount = (size_t)world->chunksPerSide * world->chunksPerSide;
+    for (size_t i = 0; i < chunkCount; i++) statFree(ALLOC_WORLD, world->chunks[i], CHUNK_SIZE * CHUNK_SIZE * sizeof(float));
+    statFree(ALLOC_WORLD, world->chunks, chunkCount * sizeof(float *));
+    world->chunks = NULL;
+    world->allocatedChunks = 0;
+}
+
+void clearWorld(World *world) {
+    for (int i = 0; i < world->chunksPerSide * world->chunksPerSide; i++)
+        if (world->chunks[i]) memset(world->chunks[i], 0, CHUNK_SIZE * CHUNK_SIZE * sizeof(float));
+}
+
+void worldSet(World *world, int x, int y, float value) {
+    float **slot = &world->chunks[(y >> CHUNK_SHIFT) * world->chunksPerSide + (x >> CHUNK_SHIFT)];
+    if (!*slot) {
+        if (value == EMPTY_VALUE) return;
+        *slot = (float *)statCalloc(ALLOC_WORLD, CHUNK_SIZE * CHUNK_SIZE, sizeof(float));
+        if (*slot == NULL) {
+            perror("Memory allocation error");
+            exit(1);
+        }
+        world->allocatedChunks++;
+    }
+    (*slot)[((y & CHUNK_MASK) << CHUNK_SHIFT) + (x & CHUNK_MASK)] = value;
+}
+
+// copies a width x height window at (x0, y0) row-major into dst, cells outside the world read as empty
+void worldReadWindow(const World *world, float *dst, int x0, int y0, int width, int height) {
+    memset(dst, 0, (size_t)width * height * sizeof(float));
+    int xStart = x0 < 0 ? 0 : x0;
+    int yStart = y0 < 0 ? 0 : y0;
+    int xEnd = x0 + width > world->size ? world->size : x0 + width;
+    int yEnd = y0 + height > world->size ? world->size : y0 + height;
+
+    for (int y = yStart; y < yEnd; y++) {
+        float *row = dst + (size_t)(y - y0) * width;
+        // copy chunk-wide runs instead of one lookup per cell
+        for (int x = xStart; x < xEnd; ) {
+            int runEnd = ((x >> CHUNK_SHIFT) + 1) << CHUNK_SHIFT;
+            if (runEnd > xEnd) runEnd = xEnd;
+            const float *chunk = worldChunk(world, x >> CHUNK_SHIFT, y >> CHUNK_SHIFT);
+            if (chunk) memcpy(row + (x - x0), chunk + ((y & CHUNK_MASK) << CHUNK_SHIFT) + (x & CHUNK_MASK), (runEnd - x) * sizeof(float));
+            x = runEnd;
+        }
+    }
+}
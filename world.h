@@ -0,0 +1,44 @@
+#ifndef WORLD_H
+#define WORLD_H
+
+#include <stdbool.h>
+
+#define FOOD_VALUE 1.0f
+#define WALL_VALUE -1.0f
+#define BODY_VALUE -0.5f // snake segment, an obstacle like walls
+#define EMPTY_VALUE 0.0f // must stay 0, untouched chunks are never allocated
+
+#define CHUNK_SHIFT 6
+#define CHUNK_SIZE (1 << CHUNK_SHIFT)
+#define CHUNK_MASK (CHUNK_SIZE - 1)
+
+// Square grid split into CHUNK_SIZE x CHUNK_SIZE tiles that are allocated on first write,
+// so large sparse worlds only pay for the chunks that hold walls, food or snakes.
+typedef struct World {
+    int size;          // cells per side
+    int chunksPerSide;
+    float **chunks;    // row-major chunk table, NULL chunks read as EMPTY_VALUE
+    int allocatedChunks;
+} World;
+
+bool initWorld(World *world, int size); // true on error
+void freeWorld(World *world);
+void clearWorld(World *world); // every cell back to empty, chunks stay allocated
+void worldSet(World *world, int x, int y, float value);
+void worldReadWindow(const World *world, float *dst, int x0, int y0, int width, int height);
+
+static inline bool worldContains(const World *world, int x, int y) {
+    return x >= 0 && y >= 0 && x < world->size && y < world->size;
+}
+
+static inline float worldGet(const World *world, int x, int y) {
+    const float *chunk = world->chunks[(y >> CHUNK_SHIFT) * world->chunksPerSide + (x >> CHUNK_SHIFT)];
+    return chunk ? chunk[((y & CHUNK_MASK) << CHUNK_SHIFT) + (x & CHUNK_MASK)] : EMPTY_VALUE;
+}
+
+// NULL if the chunk was never written
+static inline const float *worldChunk(const World *world, int cx, int cy) {
+    return world->chunks[cy * world->chunksPerSide + cx];
+}
+
+#endif // WORLD_H